@@ -0,0 +1,24 @@
+QT += concurrent
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/sceneexporter.cpp \
+    $$PWD/selectiontool.cpp \
+    $$PWD/perfview.cpp \
+    $$PWD/minimapwidget.cpp \
+    $$PWD/interactiontrace.cpp \
+    $$PWD/tracerecorder.cpp \
+    $$PWD/tracereplayer.cpp
+
+HEADERS += \
+    $$PWD/sceneexporter.h \
+    $$PWD/selectiontool.h \
+    $$PWD/perfview.h \
+    $$PWD/minimapwidget.h \
+    $$PWD/lazygeometry.h \
+    $$PWD/interactiontrace.h \
+    $$PWD/tracerecorder.h \
+    $$PWD/tracereplayer.h \
+    $$PWD/scenecommands.h
@@ -0,0 +1,141 @@
+#include "interactiontrace.h"
+#include <QDataStream>
+#include <QFile>
+
+namespace {
+
+const quint32 Magic = 0x4c545243; // "LTRC"
+const quint16 Version = 2;
+
+}
+
+bool InteractionTrace::save(const QString &fileName, QString *error) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out << Magic << Version;
+
+    out << quint32(start.nodes.size());
+    for (auto it = start.nodes.constBegin(); it != start.nodes.constEnd(); ++it) {
+        const ChangeJournal::Node &node = it.value();
+        out << qint32(it.key()) << quint8(node.kind) << node.pos.x() << node.pos.y()
+            << node.size.width() << node.size.height() << quint16(node.sides) << quint8(node.hidden);
+    }
+    out << quint32(start.links.size());
+    for (quint64 key : start.links) {
+        out << key;
+    }
+
+    out << quint32(events.size());
+
+    for (const Event &event : events) {
+        out << event.type << event.time;
+        switch (event.type) {
+        case View:
+            out << event.area.x() << event.area.y() << event.area.width() << event.area.height()
+                << quint16(event.viewport.width()) << quint16(event.viewport.height());
+            break;
+        case Action:
+            out << event.command.toUtf8();
+            break;
+        default:
+            out << event.button << event.buttons << event.modifiers << event.pos.x() << event.pos.y();
+            break;
+        }
+    }
+
+    if (out.status() != QDataStream::Ok || !file.flush()) {
+        *error = "cannot write " + fileName;
+        return false;
+    }
+    return true;
+}
+
+bool InteractionTrace::load(const QString &fileName, QString *error) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != Magic || version != Version) {
+        *error = fileName + " is not an interaction trace";
+        return false;
+    }
+
+    start = ChangeJournal::State();
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint32 id;
+        quint8 kind, hidden;
+        qreal x, y, width, height;
+        quint16 sides;
+        in >> id >> kind >> x >> y >> width >> height >> sides >> hidden;
+        const ChangeJournal::Node node = { FigureKind(kind), QPointF(x, y), QSizeF(width, height), sides, hidden != 0 };
+        start.nodes.insert(id, node);
+    }
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint64 key;
+        in >> key;
+        start.links.insert(key);
+    }
+
+    count = 0;
+    in >> count;
+    events.clear();
+    events.reserve(int(qMin<quint32>(count, 1 << 20)));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Event event = {};
+        in >> event.type >> event.time;
+        switch (event.type) {
+        case View: {
+            qreal x, y, width, height;
+            quint16 viewportWidth, viewportHeight;
+            in >> x >> y >> width >> height >> viewportWidth >> viewportHeight;
+            event.area = QRectF(x, y, width, height);
+            event.viewport = QSize(viewportWidth, viewportHeight);
+            break;
+        }
+        case Action: {
+            QByteArray command;
+            in >> command;
+            event.command = QString::fromUtf8(command);
+            break;
+        }
+        case Press:
+        case Move:
+        case Release:
+        case DoubleClick: {
+            qreal x, y;
+            in >> event.button >> event.buttons >> event.modifiers >> x >> y;
+            event.pos = QPointF(x, y);
+            break;
+        }
+        default:
+            *error = QString("%1: unknown event type %2 at event %3").arg(fileName).arg(event.type).arg(i);
+            return false;
+        }
+        events.append(event);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        *error = fileName + " is truncated";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef INTERACTIONTRACE_H
+#define INTERACTIONTRACE_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include "changejournal.h"
+
+// One recorded interaction session: the scene as it was when recording
+// started, then the mouse input the scene received, the area the view
+// showed, and the button actions taken, each stamped with milliseconds
+// since recording started. Positions are in scene coordinates, so the
+// window size at recording time does not matter.
+//
+// Files are written with QDataStream (big-endian, single-precision
+// coordinates, about 16 bytes per mouse event) so traces taken on one
+// machine replay on another.
+struct InteractionTrace {
+    enum Type : quint8 {
+        Press = 1,
+        Move,
+        Release,
+        DoubleClick,
+        View,
+        Action
+    };
+
+    struct Event {
+        quint8 type;
+        quint8 button;
+        quint8 buttons;
+        // Qt::KeyboardModifiers shifted down by ModifierShift.
+        quint8 modifiers;
+        quint32 time;
+        QPointF pos;
+        // View only.
+        QRectF area;
+        QSize viewport;
+        // Action only: the batch script line that repeats the action.
+        QString command;
+    };
+
+    enum { ModifierShift = 25 };
+
+    ChangeJournal::State start;
+    QVector<Event> events;
+
+    bool save(const QString &fileName, QString *error) const;
+    bool load(const QString &fileName, QString *error);
+};
+
+#endif // INTERACTIONTRACE_H
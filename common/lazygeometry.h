@@ -0,0 +1,258 @@
+#ifndef LAZYGEOMETRY_H
+#define LAZYGEOMETRY_H
+
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QHash>
+#include <QLineF>
+#include <QPair>
+#include <QRect>
+#include <QRectF>
+#include <QSet>
+#include <QVector>
+#include <QtMath>
+#include <functional>
+#include "edgekernel.h"
+#include "nodestore.h"
+
+// Implemented by scenes that leave some item geometry stale until it is
+// needed. Anything about to draw part of such a scene (a view, the
+// minimap, the exporter) asks it to bring that area up to date first;
+// scenes without stale geometry are left alone.
+class LazyGeometry {
+public:
+    virtual ~LazyGeometry() = default;
+
+    virtual void refreshGeometry(const QRectF &sceneRect) = 0;
+
+    static void refresh(QGraphicsScene *scene, const QRectF &sceneRect) {
+        if (LazyGeometry *lazy = dynamic_cast<LazyGeometry *>(scene)) {
+            lazy->refreshGeometry(sceneRect);
+        }
+    }
+
+    // The area every visible view currently shows.
+    static void refreshVisible(QGraphicsScene *scene) {
+        for (QGraphicsView *view : scene->views()) {
+            if (view->isVisible()) {
+                refresh(scene, view->mapToScene(view->viewport()->rect()).boundingRect());
+            }
+        }
+    }
+};
+
+// The lines a scene has left stale. Line is a QGraphicsLineItem that keeps
+// its place in the list in an int staleIndex (-1 while it is up to date),
+// so marking, dropping and deleting a line are all O(1).
+//
+// Each stale line is also filed under the grid cells covering the area it
+// can reach: where it is drawn now and the boxes around its two nodes as
+// of the last mark. Nodes only move through a mark, so a refresh collects
+// its candidates from the cells the exposed area covers instead of walking
+// every stale line. Lines that would cover more than MaxCells cells are
+// kept in a separate list every refresh looks at.
+template <typename Line>
+class StaleLines {
+public:
+    enum { CellSize = 256, MaxCells = 64 };
+
+    // endIds(line) returns the ids of the two nodes line joins in nodes.
+    using EndIds = std::function<QPair<int, int>(Line *line)>;
+
+    StaleLines(const NodeStore *nodes, EndIds endIds)
+        : nodes(nodes), endIds(endIds) {}
+
+    bool isEmpty() const { return lines.isEmpty(); }
+
+    // Also call it again when a node of an already stale line moves, so
+    // the line is filed under the area it can now reach.
+    void mark(Line *line) {
+        const QRect cells = cellsOf(reach(line));
+        if (line->staleIndex < 0) {
+            line->staleIndex = lines.size();
+            lines.append(line);
+            filed.append(cells);
+            file(line, cells);
+            return;
+        }
+        const QRect current = filed.at(line->staleIndex);
+        const QRect grown = current.united(cells);
+        if (grown != current) {
+            unfile(line, current);
+            filed[line->staleIndex] = grown;
+            file(line, grown);
+        }
+    }
+
+    // Safe on lines that are not stale, e.g. one being deleted.
+    void drop(Line *line) {
+        const int index = line->staleIndex;
+        if (index < 0) {
+            return;
+        }
+        unfile(line, filed.at(index));
+        Line *last = lines.last();
+        lines[index] = last;
+        filed[index] = filed.last();
+        last->staleIndex = index;
+        lines.removeLast();
+        filed.removeLast();
+        line->staleIndex = -1;
+    }
+
+    // Recomputes the endpoints of the visible stale lines with kernel and
+    // applies them where either where a line is or where it should be
+    // touches sceneRect; the rest stay stale. Hidden lines are left stale
+    // until a filter shows them again.
+    //
+    // Lines are culled before the kernel runs: a node's anchor is within
+    // one width and height of its position, so a line that touches neither
+    // the area nor the box around both of its nodes cannot reach the area
+    // once recomputed either.
+    void refresh(const QRectF &sceneRect, EdgeKernel &kernel) {
+        batch.resize(0);
+        from.resize(0);
+        to.resize(0);
+        for (Line *line : candidates(sceneRect)) {
+            if (!line->isVisible()) {
+                continue;
+            }
+            const QPair<int, int> ids = endIds(line);
+            const int fromSlot = nodes->slotOf(ids.first);
+            const int toSlot = nodes->slotOf(ids.second);
+            if (fromSlot < 0 || toSlot < 0) {
+                continue;
+            }
+            const QLineF current = line->line();
+            if (!touches(current.x1(), current.y1(), current.x2(), current.y2(), sceneRect)
+                    && !nodesTouch(fromSlot, toSlot, sceneRect)) {
+                continue;
+            }
+            batch.append(line);
+            from.append(fromSlot);
+            to.append(toSlot);
+        }
+        if (batch.isEmpty()) {
+            return;
+        }
+
+        kernel.compute(*nodes, from, to, endpoints);
+        for (int i = 0; i < batch.size(); ++i) {
+            Line *line = batch.at(i);
+            const QLineF current = line->line();
+            if (touches(endpoints.x1.at(i), endpoints.y1.at(i), endpoints.x2.at(i), endpoints.y2.at(i), sceneRect)
+                    || touches(current.x1(), current.y1(), current.x2(), current.y2(), sceneRect)) {
+                line->setLine(endpoints.x1.at(i), endpoints.y1.at(i), endpoints.x2.at(i), endpoints.y2.at(i));
+                drop(line);
+            }
+        }
+    }
+
+private:
+    static bool touches(qreal x1, qreal y1, qreal x2, qreal y2, const QRectF &rect) {
+        return qMin(x1, x2) <= rect.right() && qMax(x1, x2) >= rect.left()
+                && qMin(y1, y2) <= rect.bottom() && qMax(y1, y2) >= rect.top();
+    }
+
+    QRectF nodeBox(int slot) const {
+        const QPointF position = nodes->positionAt(slot);
+        const QSizeF size = nodes->sizeAt(slot);
+        return QRectF(position.x() - size.width(), position.y() - size.height(),
+                      2 * size.width(), 2 * size.height());
+    }
+
+    bool nodesTouch(int fromSlot, int toSlot, const QRectF &rect) const {
+        const QRectF box = nodeBox(fromSlot).united(nodeBox(toSlot));
+        return touches(box.left(), box.top(), box.right(), box.bottom(), rect);
+    }
+
+    // Where line is drawn now and the boxes around its nodes.
+    QRectF reach(Line *line) const {
+        const QLineF current = line->line();
+        QRectF area = QRectF(current.p1(), current.p2()).normalized();
+        const QPair<int, int> ids = endIds(line);
+        for (int id : { ids.first, ids.second }) {
+            const int slot = nodes->slotOf(id);
+            if (slot >= 0) {
+                area |= nodeBox(slot);
+            }
+        }
+        return area;
+    }
+
+    static QRect cellsOf(const QRectF &area) {
+        return QRect(QPoint(qFloor(area.left() / CellSize), qFloor(area.top() / CellSize)),
+                     QPoint(qFloor(area.right() / CellSize), qFloor(area.bottom() / CellSize)));
+    }
+
+    static bool isWide(const QRect &cells) {
+        return qint64(cells.width()) * cells.height() > MaxCells;
+    }
+
+    static quint64 cellKey(int x, int y) {
+        return (quint64(quint32(x)) << 32) | quint32(y);
+    }
+
+    void file(Line *line, const QRect &cells) {
+        if (isWide(cells)) {
+            wide.insert(line);
+            return;
+        }
+        for (int y = cells.top(); y <= cells.bottom(); ++y) {
+            for (int x = cells.left(); x <= cells.right(); ++x) {
+                buckets[cellKey(x, y)].insert(line);
+            }
+        }
+    }
+
+    void unfile(Line *line, const QRect &cells) {
+        if (isWide(cells)) {
+            wide.remove(line);
+            return;
+        }
+        for (int y = cells.top(); y <= cells.bottom(); ++y) {
+            for (int x = cells.left(); x <= cells.right(); ++x) {
+                const auto it = buckets.find(cellKey(x, y));
+                if (it != buckets.end()) {
+                    it->remove(line);
+                    if (it->isEmpty()) {
+                        buckets.erase(it);
+                    }
+                }
+            }
+        }
+    }
+
+    // The stale lines filed under a cell sceneRect covers. An area covering
+    // more cells than there are stale lines is cheaper to answer with all
+    // of them.
+    QVector<Line *> candidates(const QRectF &sceneRect) const {
+        const QRect cells = cellsOf(sceneRect);
+        if (qint64(cells.width()) * cells.height() >= lines.size()) {
+            return lines;
+        }
+        QSet<Line *> found = wide;
+        for (int y = cells.top(); y <= cells.bottom(); ++y) {
+            for (int x = cells.left(); x <= cells.right(); ++x) {
+                const auto it = buckets.constFind(cellKey(x, y));
+                if (it != buckets.constEnd()) {
+                    found += *it;
+                }
+            }
+        }
+        return found.values().toVector();
+    }
+
+    const NodeStore *nodes;
+    EndIds endIds;
+    QVector<Line *> lines;
+    QVector<QRect> filed;
+    QHash<quint64, QSet<Line *>> buckets;
+    QSet<Line *> wide;
+    QVector<Line *> batch;
+    QVector<qint32> from;
+    QVector<qint32> to;
+    EdgeKernel::Endpoints endpoints;
+};
+
+#endif // LAZYGEOMETRY_H
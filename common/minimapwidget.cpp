@@ -0,0 +1,230 @@
+#include "minimapwidget.h"
+#include "perfstats.h"
+#include "lazygeometry.h"
+#include <QElapsedTimer>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+MinimapWidget::MinimapWidget(QGraphicsView *view, QWidget *parent)
+    : QWidget(parent), view(view) {
+    refreshCategory = PerfStats::instance().category("Minimap::refresh");
+    setMinimumSize(120, 90);
+    setCursor(Qt::CrossCursor);
+
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(RefreshInterval);
+    connect(&refreshTimer, &QTimer::timeout, this, &MinimapWidget::refresh);
+
+    // Scrolling, zooming and resizing all show up as scroll bar changes or
+    // a viewport resize.
+    connect(view->horizontalScrollBar(), &QScrollBar::valueChanged, this, &MinimapWidget::updateViewportRect);
+    connect(view->verticalScrollBar(), &QScrollBar::valueChanged, this, &MinimapWidget::updateViewportRect);
+    connect(view->horizontalScrollBar(), &QScrollBar::rangeChanged, this, &MinimapWidget::updateViewportRect);
+    connect(view->verticalScrollBar(), &QScrollBar::rangeChanged, this, &MinimapWidget::updateViewportRect);
+    view->viewport()->installEventFilter(this);
+
+    if (view->scene()) {
+        connect(view->scene(), &QGraphicsScene::sceneRectChanged, this, [this]() {
+            if (isVisible()) {
+                layoutPending = true;
+                scheduleRefresh(RefreshInterval);
+            }
+        });
+    }
+}
+
+void MinimapWidget::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+    // Listening to changed() makes the scene route item updates through
+    // itself rather than straight to the views, so it is only done while
+    // someone can see the minimap.
+    if (view->scene() && !changedConnection) {
+        changedConnection = connect(view->scene(), &QGraphicsScene::changed, this, &MinimapWidget::sceneChanged);
+    }
+    layoutPending = true;
+    scheduleRefresh(0);
+}
+
+void MinimapWidget::hideEvent(QHideEvent *event) {
+    QWidget::hideEvent(event);
+    disconnect(changedConnection);
+    changedConnection = QMetaObject::Connection();
+    refreshTimer.stop();
+}
+
+void MinimapWidget::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    if (isVisible()) {
+        layoutPending = true;
+        scheduleRefresh(0);
+    }
+}
+
+void MinimapWidget::relayout() {
+    layoutPending = false;
+    sceneArea = view->scene()->sceneRect();
+    cache = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+    cache.fill(palette().color(QPalette::Base));
+
+    // Fit the scene into the widget, keeping its aspect ratio and centring
+    // the leftover space.
+    sceneToMap.reset();
+    if (!sceneArea.isEmpty()) {
+        const qreal scale = qMin(width() / sceneArea.width(), height() / sceneArea.height());
+        const qreal dx = (width() - sceneArea.width() * scale) / 2;
+        const qreal dy = (height() - sceneArea.height() * scale) / 2;
+        sceneToMap.translate(dx, dy);
+        sceneToMap.scale(scale, scale);
+        sceneToMap.translate(-sceneArea.left(), -sceneArea.top());
+    }
+
+    columns = (width() + TileSize - 1) / TileSize;
+    rows = (height() + TileSize - 1) / TileSize;
+    markAllDirty();
+    updateViewportRect();
+    update();
+}
+
+void MinimapWidget::markAllDirty() {
+    dirty.fill(1, columns * rows);
+    dirtyCount = dirty.size();
+    cursor = 0;
+}
+
+void MinimapWidget::markDirty(const QRectF &sceneRect) {
+    if (columns == 0 || dirtyCount == dirty.size()) {
+        return;
+    }
+
+    // One pixel of slack for pens and antialiasing.
+    const QRect pixels = sceneToMap.mapRect(sceneRect).toAlignedRect().adjusted(-1, -1, 1, 1)
+            .intersected(QRect(0, 0, width(), height()));
+    if (pixels.isEmpty()) {
+        return;
+    }
+
+    for (int row = pixels.top() / TileSize; row <= pixels.bottom() / TileSize && row < rows; ++row) {
+        for (int column = pixels.left() / TileSize; column <= pixels.right() / TileSize && column < columns; ++column) {
+            quint8 &tile = dirty[row * columns + column];
+            if (!tile) {
+                tile = 1;
+                ++dirtyCount;
+            }
+        }
+    }
+}
+
+void MinimapWidget::sceneChanged(const QList<QRectF> &rects) {
+    if (rects.isEmpty()) {
+        return;
+    }
+    for (const QRectF &rect : rects) {
+        markDirty(rect);
+    }
+    if (dirtyCount > 0) {
+        scheduleRefresh(RefreshInterval);
+    }
+}
+
+void MinimapWidget::scheduleRefresh(int interval) {
+    // An already running timer is only ever shortened, so a stream of
+    // changes cannot keep pushing the refresh back.
+    if (!refreshTimer.isActive() || refreshTimer.remainingTime() > interval) {
+        refreshTimer.start(interval);
+    }
+}
+
+void MinimapWidget::refresh() {
+    QGraphicsScene *scene = view->scene();
+    if (!scene || width() <= 0 || height() <= 0) {
+        return;
+    }
+    if (layoutPending) {
+        relayout();
+    }
+    if (dirtyCount == 0) {
+        return;
+    }
+
+    PerfTimer timer(refreshCategory);
+    QElapsedTimer budget;
+    budget.start();
+
+    const QTransform mapToScene = sceneToMap.inverted();
+    const QColor background = palette().color(QPalette::Base);
+    QPainter painter(&cache);
+    QRect repainted;
+
+    // Tiles are taken round-robin from where the previous tick stopped, so
+    // a steady stream of changes cannot starve any part of the map.
+    const int tiles = dirty.size();
+    for (int visited = 0; visited < tiles && dirtyCount > 0; ++visited, cursor = (cursor + 1) % tiles) {
+        if (!dirty.at(cursor)) {
+            continue;
+        }
+
+        const QRect tile = QRect((cursor % columns) * TileSize, (cursor / columns) * TileSize, TileSize, TileSize)
+                .intersected(cache.rect());
+        painter.setClipRect(tile);
+        painter.fillRect(tile, background);
+        const QRectF source = mapToScene.mapRect(QRectF(tile));
+        LazyGeometry::refresh(scene, source);
+        scene->render(&painter, QRectF(tile), source, Qt::IgnoreAspectRatio);
+        dirty[cursor] = 0;
+        --dirtyCount;
+        repainted |= tile;
+
+        if (budget.elapsed() >= RefreshBudget) {
+            cursor = (cursor + 1) % tiles;
+            break;
+        }
+    }
+    painter.end();
+
+    update(repainted);
+
+    // A backlog left over from a budget cut is drained at a quicker pace
+    // than fresh changes are picked up, but still with the event loop
+    // getting most of the time in between.
+    if (dirtyCount > 0) {
+        scheduleRefresh(CatchUpInterval);
+    }
+}
+
+void MinimapWidget::updateViewportRect() {
+    const QRectF area = sceneToMap.mapRect(view->mapToScene(view->viewport()->rect()).boundingRect());
+    if (area != viewportArea) {
+        update(viewportArea.toAlignedRect().adjusted(-2, -2, 2, 2));
+        viewportArea = area;
+        update(viewportArea.toAlignedRect().adjusted(-2, -2, 2, 2));
+    }
+}
+
+void MinimapWidget::paintEvent(QPaintEvent *event) {
+    QPainter painter(this);
+    painter.drawImage(event->rect(), cache, event->rect());
+
+    painter.setPen(QPen(palette().color(QPalette::Highlight), 1.5));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(viewportArea);
+}
+
+void MinimapWidget::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) {
+        view->centerOn(sceneToMap.inverted().map(QPointF(event->pos())));
+    }
+}
+
+void MinimapWidget::mouseMoveEvent(QMouseEvent *event) {
+    if (event->buttons() & Qt::LeftButton) {
+        view->centerOn(sceneToMap.inverted().map(QPointF(event->pos())));
+    }
+}
+
+bool MinimapWidget::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == view->viewport() && event->type() == QEvent::Resize) {
+        updateViewportRect();
+    }
+    return QWidget::eventFilter(watched, event);
+}
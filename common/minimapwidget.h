@@ -0,0 +1,69 @@
+#ifndef MINIMAPWIDGET_H
+#define MINIMAPWIDGET_H
+
+#include <QGraphicsView>
+#include <QImage>
+#include <QTimer>
+#include <QTransform>
+#include <QVector>
+#include <QWidget>
+
+// Overview of a view's whole scene. The scene is rendered once into a
+// small cached image; after that only the tiles touched by
+// QGraphicsScene::changed() are re-rendered, on a throttled timer and
+// within a per-tick time budget, so editing in the main view never waits
+// on the minimap. Draws the view's visible area on top; clicking or
+// dragging re-centres the view. While hidden the minimap does not listen
+// to the scene at all and repaints everything when shown again.
+class MinimapWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    enum {
+        TileSize = 32,
+        RefreshInterval = 200,
+        CatchUpInterval = 16,
+        RefreshBudget = 4
+    };
+
+    explicit MinimapWidget(QGraphicsView *view, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override { return QSize(240, 180); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void sceneChanged(const QList<QRectF> &rects);
+    void refresh();
+    void updateViewportRect();
+
+private:
+    void relayout();
+    void markDirty(const QRectF &sceneRect);
+    void markAllDirty();
+    void scheduleRefresh(int interval);
+
+    QGraphicsView *view;
+    QImage cache;
+    QTransform sceneToMap;
+    QRectF sceneArea;
+    QRectF viewportArea;
+    QVector<quint8> dirty;
+    int columns = 0;
+    int rows = 0;
+    int dirtyCount = 0;
+    int cursor = 0;
+    bool layoutPending = false;
+    QTimer refreshTimer;
+    QMetaObject::Connection changedConnection;
+    int refreshCategory;
+};
+
+#endif // MINIMAPWIDGET_H
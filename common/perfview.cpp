@@ -0,0 +1,109 @@
+#include "perfview.h"
+#include "perfstats.h"
+#include "lazygeometry.h"
+#include <QPainter>
+#include <QPaintEvent>
+
+PerfView::PerfView(QWidget *parent)
+    : QGraphicsView(parent) {
+    init();
+}
+
+PerfView::PerfView(QGraphicsScene *scene, QWidget *parent)
+    : QGraphicsView(scene, parent) {
+    init();
+}
+
+void PerfView::init() {
+    PerfStats &stats = PerfStats::instance();
+    frameCategory = stats.category("view.paint");
+    latencyCategory = stats.category("view.inputToPaint");
+    clock.start();
+
+    // The HUD is refreshed on its own slow timer: repainting it from
+    // paintEvent would schedule another paint every frame.
+    hudTimer.setInterval(250);
+    connect(&hudTimer, &QTimer::timeout, this, [this]() {
+        viewport()->update(hudRect());
+    });
+}
+
+void PerfView::setHudVisible(bool visible) {
+    hudVisible = visible;
+    if (visible) {
+        hudTimer.start();
+    } else {
+        hudTimer.stop();
+    }
+    viewport()->update(hudRect());
+}
+
+bool PerfView::viewportEvent(QEvent *event) {
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+    case QEvent::KeyPress:
+        if (pendingInput < 0) {
+            pendingInput = clock.nsecsElapsed();
+        }
+        break;
+    default:
+        break;
+    }
+    return QGraphicsView::viewportEvent(event);
+}
+
+void PerfView::paintEvent(QPaintEvent *event) {
+    // The HUD timer repaints only the HUD's corner; those frames say
+    // nothing about the scene and are left out of the stats.
+    if (hudVisible && hudRect().contains(event->region().boundingRect())) {
+        QGraphicsView::paintEvent(event);
+        drawHud();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if (scene()) {
+        // Geometry the scene left stale is brought up to date only for the
+        // area being exposed.
+        LazyGeometry::refresh(scene(), mapToScene(event->rect()).boundingRect().adjusted(-2, -2, 2, 2));
+    }
+    QGraphicsView::paintEvent(event);
+
+    PerfStats &stats = PerfStats::instance();
+    stats.record(frameCategory, timer.nsecsElapsed());
+    if (pendingInput >= 0) {
+        stats.record(latencyCategory, clock.nsecsElapsed() - pendingInput);
+        pendingInput = -1;
+    }
+
+    if (hudVisible) {
+        drawHud();
+    }
+}
+
+QRect PerfView::hudRect() const {
+    return QRect(8, 8, 260, 96);
+}
+
+void PerfView::drawHud() {
+    PerfStats &stats = PerfStats::instance();
+    PerfStats::Summary frame = stats.summary(frameCategory);
+    PerfStats::Summary latency = stats.summary(latencyCategory);
+    QPair<int, int> itemCounts = counts ? counts() : qMakePair(scene() ? scene()->items().size() : 0, 0);
+
+    QStringList lines;
+    lines << QString("frame p50 %1 ms  p99 %2 ms").arg(frame.p50 / 1e6, 0, 'f', 2).arg(frame.p99 / 1e6, 0, 'f', 2)
+          << QString("input->paint p50 %1 ms  p99 %2 ms").arg(latency.p50 / 1e6, 0, 'f', 2).arg(latency.p99 / 1e6, 0, 'f', 2)
+          << QString("frames %1").arg(frame.count)
+          << QString("items %1  edges %2").arg(itemCounts.first).arg(itemCounts.second);
+
+    QPainter painter(viewport());
+    QRect rect = hudRect();
+    painter.fillRect(rect, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    painter.drawText(rect.adjusted(6, 4, -6, -4), Qt::AlignLeft | Qt::AlignTop, lines.join('\n'));
+}
@@ -0,0 +1,43 @@
+#ifndef PERFVIEW_H
+#define PERFVIEW_H
+
+#include <QGraphicsView>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <functional>
+
+// QGraphicsView that times its own painting and the delay from input to
+// the next paint, feeding PerfStats, and can draw those numbers as a HUD.
+class PerfView : public QGraphicsView {
+    Q_OBJECT
+
+public:
+    explicit PerfView(QWidget *parent = nullptr);
+    explicit PerfView(QGraphicsScene *scene, QWidget *parent = nullptr);
+
+    bool isHudVisible() const { return hudVisible; }
+    void setCountsProvider(std::function<QPair<int, int>()> provider) { counts = provider; }
+
+public slots:
+    void setHudVisible(bool visible);
+    void toggleHud() { setHudVisible(!hudVisible); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    bool viewportEvent(QEvent *event) override;
+
+private:
+    void init();
+    void drawHud();
+    QRect hudRect() const;
+
+    bool hudVisible = false;
+    QTimer hudTimer;
+    QElapsedTimer clock;
+    qint64 pendingInput = -1;
+    int frameCategory;
+    int latencyCategory;
+    std::function<QPair<int, int>()> counts;
+};
+
+#endif // PERFVIEW_H
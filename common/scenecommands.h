@@ -0,0 +1,117 @@
+#ifndef SCENECOMMANDS_H
+#define SCENECOMMANDS_H
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QTransform>
+#include <functional>
+#include "objectpool.h"
+#include "processmemory.h"
+#include "scriptrunner.h"
+
+// Batch script commands both applications offer in the same form; each
+// application supplies the few calls that differ between its scenes.
+class SceneCommands {
+public:
+    // round(count) adds count scene-only items joined into a chain by
+    // count - 1 lines, then deletes them all again, without writing
+    // anything to the database or the autosave.
+    using ChurnRound = std::function<void(int count)>;
+    // Applies transform to every figure in the scene.
+    using TransformAll = std::function<void(const QTransform &transform)>;
+
+    // Registers "move DX DY" and "scale FACTOR".
+    static void addTransforms(ScriptRunner &runner, TransformAll transformAll) {
+        runner.addCommand("move", 2, "DX DY", [transformAll](const QStringList &args, QString *error) {
+            bool okX, okY;
+            const qreal dx = args.at(0).toDouble(&okX);
+            const qreal dy = args.at(1).toDouble(&okY);
+            if (!okX || !okY) {
+                *error = "DX and DY must be numbers";
+                return false;
+            }
+            transformAll(QTransform::fromTranslate(dx, dy));
+            return true;
+        });
+        runner.addCommand("scale", 1, "FACTOR", [transformAll](const QStringList &args, QString *error) {
+            bool ok;
+            const qreal factor = args.at(0).toDouble(&ok);
+            if (!ok || factor == 0) {
+                *error = "FACTOR must be a non-zero number";
+                return false;
+            }
+            transformAll(QTransform::fromScale(factor, factor));
+            return true;
+        });
+    }
+
+    // Registers "layout [new]": starts a layout of scene, or of its new
+    // figures only, and waits for it in a local event loop. Scene needs
+    // startLayout(bool newOnly) and a layoutFinished(int, bool) signal.
+    template <typename Scene>
+    static void addLayout(ScriptRunner &runner, Scene *scene) {
+        runner.addCommand("layout", 0, "[new]", [scene](const QStringList &args, QString *error) {
+            QEventLoop loop;
+            int iterations = 0;
+            QObject::connect(scene, &Scene::layoutFinished, &loop, [&](int done, bool) {
+                iterations = done;
+                loop.quit();
+            });
+            if (!scene->startLayout(args.value(0) == "new")) {
+                *error = "nothing to lay out";
+                return false;
+            }
+            loop.exec();
+            QTextStream(stdout) << "layout settled after " << iterations << " iterations\n";
+            return true;
+        });
+    }
+
+    // Registers "churn N [ROUNDS] [heap]": repeats round() and reports the
+    // time per object, the resident set before and after, and the counters
+    // of the Item and Line pools. "heap" runs it with both pools switched
+    // off, for comparison.
+    template <typename Item, typename Line>
+    static void addChurn(ScriptRunner &runner, ChurnRound round) {
+        runner.addCommand("churn", 1, "N [ROUNDS] [heap]", [round](const QStringList &args, QString *error) {
+            const int count = args.at(0).toInt();
+            const int rounds = args.size() > 1 && args.at(1) != "heap" ? args.at(1).toInt() : 1;
+            const bool pooled = !args.contains("heap");
+            if (count < 2 || rounds < 1) {
+                *error = "N must be at least 2 and ROUNDS at least 1";
+                return false;
+            }
+            if (!Item::setPoolEnabled(pooled) || !Line::setPoolEnabled(pooled)) {
+                *error = "the allocator can only be switched on an empty scene";
+                return false;
+            }
+
+            const qint64 rssBefore = residentSetBytes();
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < rounds; ++i) {
+                round(count);
+            }
+            const qint64 elapsed = timer.nsecsElapsed();
+            const qint64 rssAfter = residentSetBytes();
+
+            const PoolStats items = Item::poolStats();
+            const PoolStats lines = Line::poolStats();
+            QTextStream(stdout) << "churn " << count << " x " << rounds << (pooled ? " (pool)" : " (heap)") << ": "
+                                << QString::number(elapsed / 1e6, 'f', 1) << " ms, "
+                                << QString::number(double(elapsed) / (qint64(count) * rounds * 2 - rounds), 'f', 0)
+                                << " ns/object, rss " << rssBefore / 1024 << " -> " << rssAfter / 1024 << " KiB\n"
+                                << "  items: " << items.allocations << " alloc, " << items.frees << " free, "
+                                << items.live << " live, " << items.slabs << " slabs\n"
+                                << "  lines: " << lines.allocations << " alloc, " << lines.frees << " free, "
+                                << lines.live << " live, " << lines.slabs << " slabs\n";
+
+            Item::setPoolEnabled(true);
+            Line::setPoolEnabled(true);
+            return true;
+        });
+    }
+};
+
+#endif // SCENECOMMANDS_H
@@ -0,0 +1,223 @@
+#include "sceneexporter.h"
+#include "lazygeometry.h"
+#include <QGraphicsItem>
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+#include <QDir>
+#include <QFile>
+#include <QAtomicInt>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent>
+#include <QtMath>
+
+SceneExporter::SceneExporter(QGraphicsScene *scene, const ExportOptions &options)
+    : scene(scene), options(options) {}
+
+void SceneExporter::snapshot() {
+    primitives.clear();
+
+    // Edges never reach outside the figures they join, so the items'
+    // bounds cover everything that may still be stale.
+    LazyGeometry::refresh(scene, scene->itemsBoundingRect());
+    sourceRect = scene->itemsBoundingRect();
+    if (sourceRect.isEmpty()) {
+        sourceRect = scene->sceneRect();
+    }
+
+    QStyleOptionGraphicsItem option;
+    const QList<QGraphicsItem *> items = scene->items(Qt::AscendingOrder);
+    primitives.reserve(items.size());
+
+    for (QGraphicsItem *item : items) {
+        if (!item->isVisible() || (item->flags() & QGraphicsItem::ItemHasNoContents)) {
+            continue;
+        }
+
+        Primitive primitive;
+        primitive.transform = item->sceneTransform();
+        primitive.bounds = item->sceneBoundingRect();
+        primitive.opacity = item->effectiveOpacity();
+
+        option.rect = item->boundingRect().toAlignedRect();
+        option.exposedRect = item->boundingRect();
+
+        QPainter painter(&primitive.picture);
+        item->paint(&painter, &option, nullptr);
+        painter.end();
+
+        primitives.append(primitive);
+    }
+}
+
+QVector<SceneExporter::Tile> SceneExporter::layoutTiles(qreal scale, const QSize &pixelSize) const {
+    const int tileSize = options.tileSize;
+    const int columns = (pixelSize.width() + tileSize - 1) / tileSize;
+    const int rows = (pixelSize.height() + tileSize - 1) / tileSize;
+
+    QVector<Tile> tiles(columns * rows);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < columns; ++x) {
+            Tile &tile = tiles[y * columns + x];
+            tile.x = x;
+            tile.y = y;
+            tile.pixelRect = QRect(x * tileSize, y * tileSize,
+                                   qMin(tileSize, pixelSize.width() - x * tileSize),
+                                   qMin(tileSize, pixelSize.height() - y * tileSize));
+        }
+    }
+
+    for (int i = 0; i < primitives.size(); ++i) {
+        const QRectF bounds = primitives.at(i).bounds.translated(-sourceRect.topLeft());
+        const QRectF pixels = QRectF(bounds.topLeft() * scale, bounds.size() * scale).adjusted(-1, -1, 1, 1);
+
+        if (pixels.right() < 0 || pixels.bottom() < 0
+                || pixels.left() > pixelSize.width() || pixels.top() > pixelSize.height()) {
+            continue;
+        }
+
+        const int x0 = qBound(0, qFloor(pixels.left() / tileSize), columns - 1);
+        const int x1 = qBound(0, qFloor(pixels.right() / tileSize), columns - 1);
+        const int y0 = qBound(0, qFloor(pixels.top() / tileSize), rows - 1);
+        const int y1 = qBound(0, qFloor(pixels.bottom() / tileSize), rows - 1);
+
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                tiles[y * columns + x].items.append(i);
+            }
+        }
+    }
+
+    return tiles;
+}
+
+void SceneExporter::renderTile(QImage &image, const Tile &tile, qreal scale) const {
+    image.fill(options.background);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    QTransform base;
+    base.translate(-tile.pixelRect.x(), -tile.pixelRect.y());
+    base.scale(scale, scale);
+    base.translate(-sourceRect.left(), -sourceRect.top());
+
+    for (int index : tile.items) {
+        const Primitive &primitive = primitives.at(index);
+        painter.setWorldTransform(primitive.transform * base);
+        painter.setOpacity(primitive.opacity);
+        painter.drawPicture(0, 0, primitive.picture);
+    }
+}
+
+bool SceneExporter::writeTiles(const QString &dirPath, qreal scale) {
+    const QSize pixelSize(qCeil(sourceRect.width() * scale), qCeil(sourceRect.height() * scale));
+    if (pixelSize.isEmpty()) {
+        error = "Nothing to export: the scene is empty.";
+        return false;
+    }
+
+    if (!QDir().mkpath(dirPath)) {
+        error = "Failed to create directory " + dirPath;
+        return false;
+    }
+
+    QVector<Tile> tiles = layoutTiles(scale, pixelSize);
+    QAtomicInt failures(0);
+
+    QtConcurrent::blockingMap(tiles, [&](Tile &tile) {
+        QImage image(tile.pixelRect.size(), QImage::Format_ARGB32_Premultiplied);
+        renderTile(image, tile, scale);
+
+        const QString fileName = QString("%1/%2_%3.png").arg(dirPath).arg(tile.x).arg(tile.y);
+        if (!image.save(fileName, "PNG")) {
+            failures.ref();
+        }
+    });
+
+    if (failures.load() > 0) {
+        error = QString("Failed to write %1 tile(s) to %2").arg(failures.load()).arg(dirPath);
+        return false;
+    }
+    return true;
+}
+
+bool SceneExporter::exportImage(const QString &fileName) {
+    snapshot();
+
+    const qreal scale = options.scale;
+    const QSize pixelSize(qCeil(sourceRect.width() * scale), qCeil(sourceRect.height() * scale));
+    if (pixelSize.isEmpty()) {
+        error = "Nothing to export: the scene is empty.";
+        return false;
+    }
+
+    if (qint64(pixelSize.width()) * pixelSize.height() * 4 > options.maxStitchBytes) {
+        error = QString("A %1x%2 image is too large to stitch, export tiles instead.")
+                .arg(pixelSize.width()).arg(pixelSize.height());
+        return false;
+    }
+
+    QImage image(pixelSize, QImage::Format_ARGB32_Premultiplied);
+    if (image.isNull()) {
+        error = "Failed to allocate the output image.";
+        return false;
+    }
+
+    // Every tile paints through its own QImage header over a disjoint part
+    // of the shared buffer, so workers never touch the same scanline bytes.
+    uchar *bits = image.bits();
+    const int bytesPerLine = image.bytesPerLine();
+
+    QVector<Tile> tiles = layoutTiles(scale, pixelSize);
+    QtConcurrent::blockingMap(tiles, [&](Tile &tile) {
+        QImage view(bits + tile.pixelRect.y() * bytesPerLine + tile.pixelRect.x() * 4,
+                    tile.pixelRect.width(), tile.pixelRect.height(), bytesPerLine,
+                    QImage::Format_ARGB32_Premultiplied);
+        renderTile(view, tile, scale);
+    });
+
+    if (!image.save(fileName, "PNG")) {
+        error = "Failed to write " + fileName;
+        return false;
+    }
+    return true;
+}
+
+bool SceneExporter::exportTiles(const QString &dirPath) {
+    snapshot();
+    return writeTiles(dirPath, options.scale);
+}
+
+bool SceneExporter::exportPyramid(const QString &dirPath) {
+    snapshot();
+
+    const qreal extent = qMax(sourceRect.width(), sourceRect.height()) * options.scale;
+    int maxLevel = 0;
+    while (extent / qreal(1 << maxLevel) > options.tileSize) {
+        ++maxLevel;
+    }
+
+    for (int level = maxLevel; level >= 0; --level) {
+        const qreal scale = options.scale / qreal(1 << (maxLevel - level));
+        if (!writeTiles(QString("%1/%2").arg(dirPath).arg(level), scale)) {
+            return false;
+        }
+    }
+
+    QJsonObject descriptor;
+    descriptor["tileSize"] = options.tileSize;
+    descriptor["levels"] = maxLevel + 1;
+    descriptor["width"] = qCeil(sourceRect.width() * options.scale);
+    descriptor["height"] = qCeil(sourceRect.height() * options.scale);
+    descriptor["x"] = sourceRect.x();
+    descriptor["y"] = sourceRect.y();
+
+    QFile file(dirPath + "/pyramid.json");
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = "Failed to write " + file.fileName();
+        return false;
+    }
+    file.write(QJsonDocument(descriptor).toJson());
+    return true;
+}
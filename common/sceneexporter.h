@@ -0,0 +1,60 @@
+#ifndef SCENEEXPORTER_H
+#define SCENEEXPORTER_H
+
+#include <QGraphicsScene>
+#include <QPicture>
+#include <QTransform>
+#include <QColor>
+#include <QImage>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+
+struct ExportOptions {
+    int tileSize = 1024;
+    qreal scale = 1.0;
+    QColor background = Qt::white;
+    qint64 maxStitchBytes = qint64(256) * 1024 * 1024;
+};
+
+// Renders a scene to PNG without a view. The scene is snapshotted on the
+// calling (GUI) thread, tiles are then painted concurrently on the global
+// thread pool, so peak image memory is about maxThreadCount * tileSize^2.
+class SceneExporter {
+public:
+    explicit SceneExporter(QGraphicsScene *scene, const ExportOptions &options = ExportOptions());
+
+    bool exportImage(const QString &fileName);
+    bool exportTiles(const QString &dirPath);
+    bool exportPyramid(const QString &dirPath);
+
+    QString lastError() const { return error; }
+
+private:
+    struct Primitive {
+        QTransform transform;
+        QRectF bounds;
+        qreal opacity;
+        QPicture picture;
+    };
+
+    struct Tile {
+        int x;
+        int y;
+        QRect pixelRect;
+        QVector<int> items;
+    };
+
+    void snapshot();
+    QVector<Tile> layoutTiles(qreal scale, const QSize &pixelSize) const;
+    void renderTile(QImage &image, const Tile &tile, qreal scale) const;
+    bool writeTiles(const QString &dirPath, qreal scale);
+
+    QGraphicsScene *scene;
+    ExportOptions options;
+    QRectF sourceRect;
+    QVector<Primitive> primitives;
+    QString error;
+};
+
+#endif // SCENEEXPORTER_H
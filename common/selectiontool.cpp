@@ -0,0 +1,59 @@
+#include "selectiontool.h"
+#include <QPainterPath>
+#include <QPen>
+#include <QLineF>
+
+SelectionTool::Mode SelectionTool::modeFor(Qt::KeyboardModifiers modifiers) {
+    if (modifiers & Qt::ShiftModifier) {
+        return Rectangle;
+    }
+    if (modifiers & Qt::ControlModifier) {
+        return Lasso;
+    }
+    return None;
+}
+
+void SelectionTool::begin(Mode mode, const QPointF &pos) {
+    current = mode;
+    origin = pos;
+    outline.clear();
+    outline << pos;
+
+    overlay = new QGraphicsPathItem();
+    overlay->setPen(QPen(Qt::darkGray, 0, Qt::DashLine));
+    overlay->setBrush(QColor(0, 120, 215, 40));
+    overlay->setZValue(1e9);
+    scene->addItem(overlay);
+}
+
+void SelectionTool::update(const QPointF &pos) {
+    if (current == Rectangle) {
+        outline = QPolygonF(QRectF(origin, pos).normalized());
+    } else if (current == Lasso) {
+        // Drop points closer than two units to keep the lasso outline short.
+        if (QLineF(outline.last(), pos).length() < 2) {
+            return;
+        }
+        outline << pos;
+    } else {
+        return;
+    }
+
+    QPainterPath path;
+    path.addPolygon(outline);
+    path.closeSubpath();
+    overlay->setPath(path);
+}
+
+QPolygonF SelectionTool::finish() {
+    if (overlay) {
+        scene->removeItem(overlay);
+        delete overlay;
+        overlay = nullptr;
+    }
+
+    current = None;
+    QPolygonF result = outline;
+    outline.clear();
+    return result;
+}
@@ -0,0 +1,38 @@
+#ifndef SELECTIONTOOL_H
+#define SELECTIONTOOL_H
+
+#include <QGraphicsScene>
+#include <QGraphicsPathItem>
+#include <QPolygonF>
+
+// Tracks a rubber-band rectangle or freeform lasso drag and draws it as a
+// temporary overlay. The owning scene feeds it mouse positions and runs
+// the finished shape through its spatial index.
+class SelectionTool {
+public:
+    enum Mode {
+        None,
+        Rectangle,
+        Lasso
+    };
+
+    explicit SelectionTool(QGraphicsScene *scene) : scene(scene) {}
+
+    static Mode modeFor(Qt::KeyboardModifiers modifiers);
+
+    bool isActive() const { return current != None; }
+    Mode mode() const { return current; }
+
+    void begin(Mode mode, const QPointF &pos);
+    void update(const QPointF &pos);
+    QPolygonF finish();
+
+private:
+    QGraphicsScene *scene;
+    Mode current = None;
+    QPointF origin;
+    QPolygonF outline;
+    QGraphicsPathItem *overlay = nullptr;
+};
+
+#endif // SELECTIONTOOL_H
@@ -0,0 +1,131 @@
+#include "tracerecorder.h"
+#include <QFileDialog>
+#include <QGraphicsSceneMouseEvent>
+#include <QMessageBox>
+
+TraceRecorder::TraceRecorder(QGraphicsView *view, Snapshot snapshot, QObject *parent)
+    : QObject(parent), view(view), snapshot(snapshot) {}
+
+void TraceRecorder::start() {
+    if (recording || !view->scene()) {
+        return;
+    }
+
+    trace.start = snapshot();
+    trace.events.clear();
+    lastArea = QRectF();
+    lastViewport = QSize();
+    clock.start();
+    recording = true;
+    view->scene()->installEventFilter(this);
+    recordView();
+}
+
+InteractionTrace TraceRecorder::stop() {
+    if (recording) {
+        recording = false;
+        if (view->scene()) {
+            view->scene()->removeEventFilter(this);
+        }
+    }
+
+    InteractionTrace result;
+    qSwap(result.start, trace.start);
+    result.events.swap(trace.events);
+    return result;
+}
+
+void TraceRecorder::setRecording(bool on) {
+    if (on) {
+        start();
+        return;
+    }
+
+    const InteractionTrace trace = stop();
+    QWidget *window = view->window();
+    const QString fileName = QFileDialog::getSaveFileName(window, "Save Trace", "interaction.trace",
+                                                          "Interaction traces (*.trace)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    if (!trace.save(fileName, &error)) {
+        QMessageBox::warning(window, "Error", "Failed to save the trace: " + error);
+        return;
+    }
+    emit saved(fileName, trace.events.size());
+}
+
+bool TraceRecorder::isScriptSafe(const QString &argument) {
+    // ScriptRunner splits on whitespace and cuts comments at '#'.
+    if (argument.isEmpty() || argument.contains('#')) {
+        return false;
+    }
+    for (const QChar c : argument) {
+        if (c.isSpace()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TraceRecorder::recordAction(const QString &command) {
+    if (!recording) {
+        return;
+    }
+
+    InteractionTrace::Event event = {};
+    event.type = InteractionTrace::Action;
+    event.time = quint32(clock.elapsed());
+    event.command = command;
+    trace.events.append(event);
+}
+
+void TraceRecorder::recordView() {
+    // Checked before every mouse event rather than tracked through the
+    // scroll bars; the area only matters once there is input to replay.
+    const QSize viewport = view->viewport()->size();
+    const QRectF area = view->mapToScene(view->viewport()->rect()).boundingRect();
+    if (area == lastArea && viewport == lastViewport) {
+        return;
+    }
+    lastArea = area;
+    lastViewport = viewport;
+
+    InteractionTrace::Event event = {};
+    event.type = InteractionTrace::View;
+    event.time = quint32(clock.elapsed());
+    event.area = area;
+    event.viewport = viewport;
+    trace.events.append(event);
+}
+
+bool TraceRecorder::eventFilter(QObject *watched, QEvent *event) {
+    if (!recording || watched != view->scene()) {
+        return QObject::eventFilter(watched, event);
+    }
+
+    quint8 type;
+    switch (event->type()) {
+    case QEvent::GraphicsSceneMousePress: type = InteractionTrace::Press; break;
+    case QEvent::GraphicsSceneMouseMove: type = InteractionTrace::Move; break;
+    case QEvent::GraphicsSceneMouseRelease: type = InteractionTrace::Release; break;
+    case QEvent::GraphicsSceneMouseDoubleClick: type = InteractionTrace::DoubleClick; break;
+    default: return QObject::eventFilter(watched, event);
+    }
+
+    recordView();
+
+    const QGraphicsSceneMouseEvent *mouse = static_cast<QGraphicsSceneMouseEvent *>(event);
+    InteractionTrace::Event recorded = {};
+    recorded.type = type;
+    recorded.time = quint32(clock.elapsed());
+    recorded.button = quint8(mouse->button());
+    recorded.buttons = quint8(mouse->buttons());
+    recorded.modifiers = quint8(uint(mouse->modifiers()) >> InteractionTrace::ModifierShift);
+    recorded.pos = mouse->scenePos();
+    trace.events.append(recorded);
+
+    return QObject::eventFilter(watched, event);
+}
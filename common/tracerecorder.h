@@ -0,0 +1,58 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QElapsedTimer>
+#include <QGraphicsView>
+#include <QObject>
+#include <functional>
+#include "interactiontrace.h"
+
+// Records what a view's scene goes through while the user works: the
+// scene as recording starts (from the application's snapshot function),
+// every mouse event the scene handles (taken from an event filter, so
+// hover moves are included, exactly as the scene sees them), the visible
+// area whenever it has changed, and the actions the application reports
+// through recordAction(). Costs nothing while not recording.
+class TraceRecorder : public QObject {
+    Q_OBJECT
+
+public:
+    using Snapshot = std::function<ChangeJournal::State()>;
+
+    TraceRecorder(QGraphicsView *view, Snapshot snapshot, QObject *parent = nullptr);
+
+    bool isRecording() const { return recording; }
+    void start();
+    InteractionTrace stop();
+
+    // command is the batch script line that repeats the action, e.g.
+    // "polygon 6 50 17"; ignored while not recording. Free-form arguments
+    // such as paths must pass isScriptSafe(), or the action is better not
+    // recorded at all than replayed with different arguments.
+    void recordAction(const QString &command);
+    static bool isScriptSafe(const QString &argument);
+
+public slots:
+    // For a checkable "Record Trace" action: starts recording, or stops
+    // and asks where to save the trace.
+    void setRecording(bool on);
+
+signals:
+    void saved(const QString &fileName, int events);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void recordView();
+
+    QGraphicsView *view;
+    Snapshot snapshot;
+    InteractionTrace trace;
+    QElapsedTimer clock;
+    QRectF lastArea;
+    QSize lastViewport;
+    bool recording = false;
+};
+
+#endif // TRACERECORDER_H
@@ -0,0 +1,174 @@
+#include "tracereplayer.h"
+#include "lazygeometry.h"
+#include "perfstats.h"
+#include <QCoreApplication>
+#include <QGraphicsSceneMouseEvent>
+#include <QPainter>
+
+TraceReplayer::TraceReplayer(QGraphicsScene *scene) : scene(scene) {
+    PerfStats &stats = PerfStats::instance();
+    categories[PressCategory] = stats.category("replay:press");
+    categories[MoveCategory] = stats.category("replay:move");
+    categories[ReleaseCategory] = stats.category("replay:release");
+    categories[ActionCategory] = stats.category("replay:action");
+    categories[FrameCategory] = stats.category("replay:frame");
+}
+
+bool TraceReplayer::run(const InteractionTrace &trace) {
+    quint32 nextFrame = FrameInterval;
+
+    for (const InteractionTrace::Event &event : trace.events) {
+        // Whatever happened in the previous frame slot is painted before
+        // the first event of a later one.
+        if (event.time >= nextFrame) {
+            renderFrame();
+            nextFrame = (event.time / FrameInterval + 1) * FrameInterval;
+        }
+
+        switch (event.type) {
+        case InteractionTrace::View:
+            setView(event.area, event.viewport);
+            break;
+        case InteractionTrace::Action: {
+            if (!actionHandler) {
+                break;
+            }
+            QString message;
+            bool ok;
+            {
+                PerfTimer timer(categories[ActionCategory]);
+                ok = actionHandler(event.command, &message);
+            }
+            if (!ok) {
+                error = QString("%1 ms: %2: %3").arg(event.time).arg(event.command, message);
+                return false;
+            }
+            break;
+        }
+        default:
+            sendMouse(event);
+            break;
+        }
+
+        ++events;
+        duration = event.time;
+    }
+
+    renderFrame();
+    return true;
+}
+
+void TraceReplayer::sendMouse(const InteractionTrace::Event &event) {
+    QEvent::Type type;
+    int category;
+    switch (event.type) {
+    case InteractionTrace::Press: type = QEvent::GraphicsSceneMousePress; category = PressCategory; break;
+    case InteractionTrace::Release: type = QEvent::GraphicsSceneMouseRelease; category = ReleaseCategory; break;
+    case InteractionTrace::DoubleClick: type = QEvent::GraphicsSceneMouseDoubleClick; category = PressCategory; break;
+    default: type = QEvent::GraphicsSceneMouseMove; category = MoveCategory; break;
+    }
+
+    if (type != QEvent::GraphicsSceneMouseMove) {
+        for (int i = 0; i < ButtonCount; ++i) {
+            if (event.button == (1 << i)) {
+                buttonDownScenePos[i] = event.pos;
+            }
+        }
+    }
+
+    // Sent without a widget, the scene hit-tests by scene position alone;
+    // nothing in these scenes ignores the view transform, so it finds the
+    // same items a view would.
+    QGraphicsSceneMouseEvent mouse(type);
+    mouse.setScenePos(event.pos);
+    mouse.setScreenPos(event.pos.toPoint());
+    mouse.setLastScenePos(lastScenePos);
+    mouse.setLastScreenPos(lastScenePos.toPoint());
+    mouse.setButton(Qt::MouseButton(event.button));
+    mouse.setButtons(Qt::MouseButtons(event.buttons));
+    mouse.setModifiers(Qt::KeyboardModifiers(uint(event.modifiers) << InteractionTrace::ModifierShift));
+    for (int i = 0; i < ButtonCount; ++i) {
+        const Qt::MouseButton button = Qt::MouseButton(1 << i);
+        mouse.setButtonDownScenePos(button, buttonDownScenePos[i]);
+        mouse.setButtonDownScreenPos(button, buttonDownScenePos[i].toPoint());
+    }
+    mouse.setAccepted(false);
+    lastScenePos = event.pos;
+
+    PerfTimer timer(categories[category]);
+    QCoreApplication::sendEvent(scene, &mouse);
+}
+
+void TraceReplayer::setView(const QRectF &sceneArea, const QSize &viewport) {
+    area = sceneArea;
+    if (frame.size() != viewport) {
+        frame = viewport.isEmpty() ? QImage() : QImage(viewport, QImage::Format_ARGB32_Premultiplied);
+    }
+}
+
+void TraceReplayer::renderFrame() {
+    PerfTimer timer(categories[FrameCategory]);
+
+    // Only posted events, not timers, so the result does not depend on
+    // how long the replay has taken so far. This is where the scene's
+    // index updates and changed() notifications run.
+    QCoreApplication::sendPostedEvents();
+
+    if (frame.isNull()) {
+        return;
+    }
+
+    LazyGeometry::refresh(scene, area);
+    frame.fill(Qt::white);
+    QPainter painter(&frame);
+    painter.setRenderHint(QPainter::Antialiasing);
+    scene->render(&painter, QRectF(frame.rect()), area, Qt::IgnoreAspectRatio);
+    ++frames;
+}
+
+void TraceReplayer::addCommand(ScriptRunner &runner, QGraphicsScene *scene, RestoreHandler restore) {
+    ScriptRunner *script = &runner;
+    runner.addCommand("replay", 1, "TRACE", [script, scene, restore](const QStringList &args, QString *error) {
+        InteractionTrace trace;
+        if (!trace.load(args.at(0), error) || !restore(trace.start, error)) {
+            return false;
+        }
+
+        TraceReplayer replayer(scene);
+        replayer.setActionHandler([script](const QString &command, QString *actionError) {
+            if (!script->runLine(command)) {
+                *actionError = script->lastError();
+                return false;
+            }
+            return true;
+        });
+        if (!replayer.run(trace)) {
+            *error = replayer.lastError();
+            return false;
+        }
+
+        QTextStream out(stdout);
+        replayer.printReport(out);
+        return true;
+    });
+}
+
+void TraceReplayer::printReport(QTextStream &out) const {
+    static const char *const names[CategoryCount] = { "press", "move", "release", "action", "frame" };
+
+    out << QString("%1 %2 %3 %4 %5\n")
+           .arg("replay", -14).arg("count", 8).arg("p50 us", 9).arg("p99 us", 9).arg("max us", 9);
+
+    for (int i = 0; i < CategoryCount; ++i) {
+        const PerfStats::Summary summary = PerfStats::instance().summary(categories[i]);
+        if (summary.count == 0) {
+            continue;
+        }
+        out << QString("%1 %2 %3 %4 %5\n")
+               .arg(names[i], -14).arg(summary.count, 8)
+               .arg(summary.p50 / 1e3, 9, 'f', 1).arg(summary.p99 / 1e3, 9, 'f', 1)
+               .arg(summary.max / 1e3, 9, 'f', 1);
+    }
+
+    out << QString("%1 events over %2 ms recorded, %3 frames\n").arg(events).arg(duration).arg(frames);
+}
@@ -0,0 +1,75 @@
+#ifndef TRACEREPLAYER_H
+#define TRACEREPLAYER_H
+
+#include <QGraphicsScene>
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+#include <QTextStream>
+#include <functional>
+#include "interactiontrace.h"
+#include "scriptrunner.h"
+
+// Drives a recorded trace into a scene without a view or a display. Mouse
+// events are sent to the scene exactly as a view would send them; actions
+// go to the application's handler, normally its batch script runner.
+// Recorded time only decides where frames fall: whenever it crosses a
+// FrameInterval boundary the scene's pending updates are delivered and the
+// recorded visible area is rendered offscreen, and nothing waits in
+// between, so a replay is deterministic and runs as fast as the code
+// under test allows.
+//
+// Handler and frame times go to PerfStats ("replay:press", "replay:move",
+// "replay:release", "replay:action", "replay:frame").
+class TraceReplayer {
+public:
+    using ActionHandler = std::function<bool(const QString &command, QString *error)>;
+    using RestoreHandler = std::function<bool(const ChangeJournal::State &state, QString *error)>;
+
+    enum { FrameInterval = 16 };
+
+    explicit TraceReplayer(QGraphicsScene *scene);
+
+    void setActionHandler(ActionHandler handler) { actionHandler = handler; }
+
+    bool run(const InteractionTrace &trace);
+    void printReport(QTextStream &out) const;
+
+    QString lastError() const { return error; }
+
+    // Registers "replay TRACE" on runner: restore loads the trace's
+    // starting scene into the application, then the trace runs against
+    // scene with its actions executed as lines of runner, so they are
+    // timed and counted like any other command too.
+    static void addCommand(ScriptRunner &runner, QGraphicsScene *scene, RestoreHandler restore);
+
+private:
+    enum Category {
+        PressCategory,
+        MoveCategory,
+        ReleaseCategory,
+        ActionCategory,
+        FrameCategory,
+        CategoryCount
+    };
+
+    enum { ButtonCount = 8 };
+
+    void sendMouse(const InteractionTrace::Event &event);
+    void setView(const QRectF &sceneArea, const QSize &viewport);
+    void renderFrame();
+
+    QGraphicsScene *scene;
+    ActionHandler actionHandler;
+    int categories[CategoryCount];
+    QImage frame;
+    QRectF area;
+    QPointF lastScenePos;
+    QPointF buttonDownScenePos[ButtonCount];
+    quint64 events = 0;
+    quint64 frames = 0;
+    quint32 duration = 0;
+    QString error;
+};
+
+#endif // TRACEREPLAYER_H
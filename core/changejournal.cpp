@@ -0,0 +1,486 @@
+#include "changejournal.h"
+#include "nodestore.h"
+#include "perfstats.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <cstring>
+
+static_assert(sizeof(ChangeJournal::Record) == 28, "journal records must stay fixed-size and unpadded");
+
+namespace {
+
+const char JournalMagic[4] = { 'S', 'J', 'N', 'L' };
+const quint32 SnapshotMagic = 0x534e4150;
+const quint32 FormatVersion = 1;
+const qint64 HeaderSize = 16;
+
+ChangeJournal::Record makeRecord(ChangeJournal::Op op, int id, int other = 0) {
+    ChangeJournal::Record record;
+    std::memset(&record, 0, sizeof(record));
+    record.op = op;
+    record.id = id;
+    record.other = other;
+    return record;
+}
+
+}
+
+class ChangeJournal::Writer : public QThread {
+public:
+    explicit Writer(ChangeJournal *journal) : journal(journal) {}
+
+protected:
+    void run() override { journal->writeLoop(); }
+
+private:
+    ChangeJournal *journal;
+};
+
+quint64 ChangeJournal::State::linkKey(int a, int b) {
+    return (quint64(quint32(qMin(a, b))) << 32) | quint32(qMax(a, b));
+}
+
+QPair<int, int> ChangeJournal::State::linkIds(quint64 key) {
+    return qMakePair(int(quint32(key >> 32)), int(quint32(key)));
+}
+
+ChangeJournal::State ChangeJournal::State::fromNodes(const NodeStore &store) {
+    State state;
+    state.nodes.reserve(store.size());
+    for (int slot = 0; slot < store.size(); ++slot) {
+        const Node node = { store.kindAt(slot), store.positionAt(slot), store.sizeAt(slot),
+                            store.sidesAt(slot), store.testFlag(slot, NodeStore::Hidden) };
+        state.nodes.insert(store.idAt(slot), node);
+    }
+    return state;
+}
+
+ChangeJournal::ChangeJournal(const QString &directory)
+    : directory(directory) {}
+
+ChangeJournal::~ChangeJournal() {
+    stop();
+}
+
+bool ChangeJournal::load(const QString &directory, State *state, QString *error) {
+    static const int category = PerfStats::instance().category("ChangeJournal::load");
+    PerfTimer timer(category);
+
+    state->nodes.clear();
+    state->links.clear();
+
+    QDir dir(directory);
+    QFile snapshotFile(dir.filePath("snapshot.bin"));
+    if (snapshotFile.exists()) {
+        if (!snapshotFile.open(QIODevice::ReadOnly)) {
+            *error = snapshotFile.errorString();
+            return false;
+        }
+
+        QDataStream in(&snapshotFile);
+        quint32 magic, version;
+        qint32 nodeCount;
+        in >> magic >> version >> nodeCount;
+        if (magic != SnapshotMagic || version != FormatVersion || nodeCount < 0) {
+            *error = "unrecognized snapshot " + snapshotFile.fileName();
+            return false;
+        }
+
+        state->nodes.reserve(nodeCount);
+        for (int i = 0; i < nodeCount && in.status() == QDataStream::Ok; ++i) {
+            qint32 id, sides;
+            quint8 kind;
+            float x, y, width, height;
+            bool hidden;
+            in >> id >> kind >> x >> y >> width >> height >> sides >> hidden;
+            Node node = { FigureKind(kind), QPointF(x, y), QSizeF(width, height), sides, hidden };
+            state->nodes.insert(id, node);
+        }
+
+        qint32 linkCount = 0;
+        in >> linkCount;
+        state->links.reserve(linkCount);
+        for (int i = 0; i < linkCount && in.status() == QDataStream::Ok; ++i) {
+            quint64 key;
+            in >> key;
+            state->links.insert(key);
+        }
+
+        if (in.status() != QDataStream::Ok) {
+            *error = "truncated snapshot " + snapshotFile.fileName();
+            return false;
+        }
+    }
+
+    QFile journalFile(dir.filePath("journal.bin"));
+    if (!journalFile.exists()) {
+        return true;
+    }
+    if (!journalFile.open(QIODevice::ReadOnly)) {
+        *error = journalFile.errorString();
+        return false;
+    }
+
+    char header[HeaderSize];
+    if (journalFile.read(header, HeaderSize) != HeaderSize) {
+        return true;
+    }
+    quint32 version, recordSize;
+    std::memcpy(&version, header + 4, sizeof(version));
+    std::memcpy(&recordSize, header + 8, sizeof(recordSize));
+    if (std::memcmp(header, JournalMagic, sizeof(JournalMagic)) != 0 || version != FormatVersion
+            || recordSize != sizeof(Record)) {
+        *error = "unrecognized journal " + journalFile.fileName();
+        return false;
+    }
+
+    // A crash can leave a partial record at the end; it is ignored.
+    const int count = int((journalFile.size() - HeaderSize) / qint64(sizeof(Record)));
+    QVector<Record> records(count);
+    if (journalFile.read(reinterpret_cast<char *>(records.data()), qint64(count) * sizeof(Record))
+            != qint64(count) * qint64(sizeof(Record))) {
+        *error = journalFile.errorString();
+        return false;
+    }
+    apply(*state, records.constData(), count);
+    return true;
+}
+
+void ChangeJournal::apply(State &state, const Record *records, int count) {
+    // Deletes arrive one record per id; consecutive ones are collected so
+    // their links are dropped in a single pass.
+    QSet<int> deleted;
+    auto dropLinks = [&]() {
+        if (deleted.isEmpty()) {
+            return;
+        }
+        for (auto it = state.links.begin(); it != state.links.end(); ) {
+            const QPair<int, int> ids = State::linkIds(*it);
+            if (deleted.contains(ids.first) || deleted.contains(ids.second)) {
+                it = state.links.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        deleted.clear();
+    };
+
+    for (int i = 0; i < count; ++i) {
+        const Record &record = records[i];
+        if (record.op != Delete) {
+            dropLinks();
+        }
+
+        switch (record.op) {
+        case Add: {
+            Node node = { FigureKind(record.kind), QPointF(record.x, record.y),
+                          QSizeF(record.width, record.height), record.sides, false };
+            state.nodes.insert(record.id, node);
+            break;
+        }
+        case Move: {
+            auto it = state.nodes.find(record.id);
+            if (it != state.nodes.end()) {
+                it->pos = QPointF(record.x, record.y);
+            }
+            break;
+        }
+        case Link:
+            if (record.id != record.other && state.nodes.contains(record.id) && state.nodes.contains(record.other)) {
+                state.links.insert(State::linkKey(record.id, record.other));
+            }
+            break;
+        case Unlink:
+            state.links.remove(State::linkKey(record.id, record.other));
+            break;
+        case Delete:
+            if (state.nodes.remove(record.id)) {
+                deleted.insert(record.id);
+            }
+            break;
+        case Hide:
+        case Show: {
+            auto it = state.nodes.find(record.id);
+            if (it != state.nodes.end()) {
+                it->hidden = record.op == Hide;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    dropLinks();
+}
+
+bool ChangeJournal::start(const State &state, int records, int interval) {
+    if (writer) {
+        return false;
+    }
+    if (!QDir().mkpath(directory)) {
+        QMutexLocker locker(&mutex);
+        error = "cannot create " + directory;
+        return false;
+    }
+
+    shadow = state;
+    compactRecords = records;
+    compactInterval = interval;
+    stopping = false;
+    writer = new Writer(this);
+    writer->start(QThread::LowPriority);
+    return true;
+}
+
+void ChangeJournal::stop() {
+    if (!writer) {
+        return;
+    }
+
+    {
+        // A clean shutdown leaves a fresh snapshot and an empty journal.
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        ++compactRequests;
+        wake.wakeOne();
+    }
+    writer->wait();
+    delete writer;
+    writer = nullptr;
+}
+
+void ChangeJournal::enqueue(const Record &record) {
+    QMutexLocker locker(&mutex);
+    queue.append(record);
+    ++recorded;
+    wake.wakeOne();
+}
+
+void ChangeJournal::recordAdd(int id, FigureKind kind, const QPointF &pos, const QSizeF &size, int sides) {
+    Record record = makeRecord(Add, id);
+    record.kind = quint8(kind);
+    record.sides = quint16(sides);
+    record.x = float(pos.x());
+    record.y = float(pos.y());
+    record.width = float(size.width());
+    record.height = float(size.height());
+    enqueue(record);
+}
+
+void ChangeJournal::recordMove(int id, const QPointF &pos) {
+    Record record = makeRecord(Move, id);
+    record.x = float(pos.x());
+    record.y = float(pos.y());
+    enqueue(record);
+}
+
+void ChangeJournal::recordMoves(const QVector<int> &ids, const QVector<QPointF> &positions) {
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < ids.size() && i < positions.size(); ++i) {
+        Record record = makeRecord(Move, ids.at(i));
+        record.x = float(positions.at(i).x());
+        record.y = float(positions.at(i).y());
+        queue.append(record);
+        ++recorded;
+    }
+    wake.wakeOne();
+}
+
+void ChangeJournal::recordLink(int a, int b) {
+    enqueue(makeRecord(Link, a, b));
+}
+
+void ChangeJournal::recordLinks(const QVector<QPair<int, int>> &pairs) {
+    QMutexLocker locker(&mutex);
+    for (const QPair<int, int> &pair : pairs) {
+        queue.append(makeRecord(Link, pair.first, pair.second));
+        ++recorded;
+    }
+    wake.wakeOne();
+}
+
+void ChangeJournal::recordUnlink(int a, int b) {
+    enqueue(makeRecord(Unlink, a, b));
+}
+
+void ChangeJournal::recordUnlinks(const QVector<QPair<int, int>> &pairs) {
+    QMutexLocker locker(&mutex);
+    for (const QPair<int, int> &pair : pairs) {
+        queue.append(makeRecord(Unlink, pair.first, pair.second));
+        ++recorded;
+    }
+    wake.wakeOne();
+}
+
+void ChangeJournal::recordDelete(const QVector<int> &ids) {
+    QMutexLocker locker(&mutex);
+    for (int id : ids) {
+        queue.append(makeRecord(Delete, id));
+        ++recorded;
+    }
+    wake.wakeOne();
+}
+
+void ChangeJournal::recordHidden(const QVector<int> &ids, bool hidden) {
+    QMutexLocker locker(&mutex);
+    for (int id : ids) {
+        queue.append(makeRecord(hidden ? Hide : Show, id));
+        ++recorded;
+    }
+    wake.wakeOne();
+}
+
+void ChangeJournal::flush(bool compact) {
+    QMutexLocker locker(&mutex);
+    if (!writer) {
+        return;
+    }
+
+    const quint64 target = recorded;
+    const quint64 passes = compactPasses;
+    if (compact) {
+        ++compactRequests;
+    }
+    wake.wakeOne();
+    while (written < target || (compact && compactPasses == passes)) {
+        drained.wait(&mutex);
+    }
+}
+
+ChangeJournal::Stats ChangeJournal::stats() const {
+    QMutexLocker locker(&mutex);
+    Stats result = { recorded, written, compactions, journalBytes };
+    return result;
+}
+
+QString ChangeJournal::lastError() const {
+    QMutexLocker locker(&mutex);
+    return error;
+}
+
+bool ChangeJournal::writeHeader(QFile &file) {
+    char header[HeaderSize] = {};
+    const quint32 recordSize = sizeof(Record);
+    std::memcpy(header, JournalMagic, sizeof(JournalMagic));
+    std::memcpy(header + 4, &FormatVersion, sizeof(FormatVersion));
+    std::memcpy(header + 8, &recordSize, sizeof(recordSize));
+    return file.write(header, HeaderSize) == HeaderSize;
+}
+
+void ChangeJournal::writeLoop() {
+    static const int writeCategory = PerfStats::instance().category("ChangeJournal::write");
+    static const int compactCategory = PerfStats::instance().category("ChangeJournal::compact");
+
+    QFile file(QDir(directory).filePath("journal.bin"));
+    QString failure;
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        failure = file.errorString();
+    } else if (file.size() < HeaderSize && (!file.resize(0) || !writeHeader(file))) {
+        failure = file.errorString();
+    }
+
+    // Records left over from the previous session are already in the
+    // shadow state and count towards the next compaction.
+    quint64 uncompacted = file.isOpen() ? quint64((file.size() - HeaderSize) / qint64(sizeof(Record))) : 0;
+    QElapsedTimer sinceCompaction;
+    sinceCompaction.start();
+
+    QMutexLocker locker(&mutex);
+    if (!failure.isEmpty()) {
+        error = failure;
+        qWarning() << "Autosave disabled:" << failure;
+    }
+
+    while (true) {
+        if (queue.isEmpty() && !stopping && compactRequests == 0) {
+            const qint64 left = compactInterval - sinceCompaction.elapsed();
+            if (uncompacted == 0) {
+                wake.wait(&mutex);
+            } else if (left > 0) {
+                wake.wait(&mutex, ulong(left));
+            }
+        }
+
+        QVector<Record> batch;
+        batch.swap(queue);
+        const bool requested = compactRequests > 0;
+        compactRequests = 0;
+        const bool done = stopping;
+        locker.unlock();
+
+        failure.clear();
+        if (!batch.isEmpty()) {
+            PerfTimer timer(writeCategory);
+            const qint64 bytes = qint64(batch.size()) * sizeof(Record);
+            if (file.isOpen() && (file.write(reinterpret_cast<const char *>(batch.constData()), bytes) != bytes
+                                  || !file.flush())) {
+                failure = "journal write failed: " + file.errorString();
+            }
+            apply(shadow, batch.constData(), batch.size());
+            uncompacted += batch.size();
+        }
+
+        bool compacted = false;
+        if (uncompacted > 0 && (requested || uncompacted >= quint64(compactRecords)
+                                || sinceCompaction.elapsed() >= compactInterval)) {
+            PerfTimer timer(compactCategory);
+            if (!writeSnapshot()) {
+                failure = "snapshot write failed";
+            } else if (file.isOpen() && (!file.resize(0) || !writeHeader(file) || !file.flush())) {
+                failure = "journal truncation failed: " + file.errorString();
+            } else {
+                uncompacted = 0;
+                compacted = true;
+            }
+            sinceCompaction.restart();
+        }
+
+        locker.relock();
+        written += batch.size();
+        journalBytes = file.isOpen() ? file.size() : 0;
+        if (compacted) {
+            ++compactions;
+        }
+        if (requested) {
+            ++compactPasses;
+        }
+        if (!failure.isEmpty()) {
+            error = failure;
+            qWarning() << "Autosave:" << failure;
+        }
+        drained.wakeAll();
+
+        if (done && queue.isEmpty()) {
+            break;
+        }
+    }
+}
+
+bool ChangeJournal::writeSnapshot() {
+    QSaveFile file(QDir(directory).filePath("snapshot.bin"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << SnapshotMagic << FormatVersion << qint32(shadow.nodes.size());
+    for (auto it = shadow.nodes.constBegin(); it != shadow.nodes.constEnd(); ++it) {
+        const Node &node = it.value();
+        out << qint32(it.key()) << quint8(node.kind)
+            << float(node.pos.x()) << float(node.pos.y())
+            << float(node.size.width()) << float(node.size.height())
+            << qint32(node.sides) << node.hidden;
+    }
+    out << qint32(shadow.links.size());
+    for (quint64 key : shadow.links) {
+        out << key;
+    }
+
+    // QSaveFile replaces the old snapshot atomically on commit.
+    return out.status() == QDataStream::Ok && file.commit();
+}
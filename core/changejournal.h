@@ -0,0 +1,139 @@
+#ifndef CHANGEJOURNAL_H
+#define CHANGEJOURNAL_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPointF>
+#include <QSet>
+#include <QSizeF>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+#include "figurekind.h"
+
+class NodeStore;
+
+// Autosave as an append-only log of scene mutations. Callers only enqueue
+// fixed-size records; a writer thread appends them to journal.bin, keeps
+// a shadow copy of the scene state, and from time to time folds that
+// state into snapshot.bin and truncates the journal. Recovery loads the
+// snapshot and replays whatever the journal holds on top of it. Replay is
+// idempotent, so a crash between writing a snapshot and truncating the
+// journal loses nothing.
+//
+// Records are written in host byte order; the files are a crash-recovery
+// aid for the same machine, not an exchange format.
+class ChangeJournal {
+public:
+    enum Op : quint8 {
+        Add = 1,
+        Move,
+        Link,
+        Unlink,
+        Delete,
+        Hide,
+        Show
+    };
+
+    struct Record {
+        quint8 op;
+        quint8 kind;
+        quint16 sides;
+        qint32 id;
+        qint32 other;
+        float x;
+        float y;
+        float width;
+        float height;
+    };
+
+    struct Node {
+        FigureKind kind;
+        QPointF pos;
+        QSizeF size;
+        int sides;
+        bool hidden;
+    };
+
+    struct State {
+        QHash<int, Node> nodes;
+        QSet<quint64> links;
+
+        static quint64 linkKey(int a, int b);
+        static QPair<int, int> linkIds(quint64 key);
+
+        // The nodes of a live scene; links are left to the caller.
+        static State fromNodes(const NodeStore &store);
+    };
+
+    struct Stats {
+        quint64 recorded;
+        quint64 written;
+        quint64 compactions;
+        qint64 journalBytes;
+    };
+
+    explicit ChangeJournal(const QString &directory);
+    ~ChangeJournal();
+
+    // Fills state from the snapshot and journal in directory; a missing
+    // directory is an empty state, not an error.
+    static bool load(const QString &directory, State *state, QString *error);
+
+    // Starts the writer with the state load() returned. Compaction runs
+    // after compactRecords records or compactInterval milliseconds,
+    // whichever comes first.
+    bool start(const State &state, int compactRecords = 500000, int compactInterval = 60000);
+    void stop();
+    bool isActive() const { return writer != nullptr; }
+
+    void recordAdd(int id, FigureKind kind, const QPointF &pos, const QSizeF &size, int sides);
+    void recordMove(int id, const QPointF &pos);
+    void recordMoves(const QVector<int> &ids, const QVector<QPointF> &positions);
+    void recordLink(int a, int b);
+    void recordLinks(const QVector<QPair<int, int>> &pairs);
+    void recordUnlink(int a, int b);
+    void recordUnlinks(const QVector<QPair<int, int>> &pairs);
+    void recordDelete(const QVector<int> &ids);
+    void recordHidden(const QVector<int> &ids, bool hidden);
+
+    // Blocks until everything enqueued so far is on disk; with compact
+    // set, also until it has been folded into a snapshot.
+    void flush(bool compact = false);
+
+    Stats stats() const;
+    QString lastError() const;
+
+private:
+    class Writer;
+
+    void enqueue(const Record &record);
+    void writeLoop();
+    bool writeSnapshot();
+    static bool writeHeader(QFile &file);
+    static void apply(State &state, const Record *records, int count);
+
+    QString directory;
+    Writer *writer = nullptr;
+
+    mutable QMutex mutex;
+    QWaitCondition wake;
+    QWaitCondition drained;
+    QVector<Record> queue;
+    bool stopping = false;
+    int compactRequests = 0;
+    quint64 compactPasses = 0;
+    quint64 recorded = 0;
+    quint64 written = 0;
+    quint64 compactions = 0;
+    qint64 journalBytes = 0;
+    QString error;
+
+    // Owned by the writer thread while it runs.
+    State shadow;
+    int compactRecords = 0;
+    int compactInterval = 0;
+};
+
+#endif // CHANGEJOURNAL_H
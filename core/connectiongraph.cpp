@@ -0,0 +1,118 @@
+#include "connectiongraph.h"
+
+ConnectionGraph ConnectionGraph::build(const QVector<QPair<int, int>> &edges) {
+    ConnectionGraph graph;
+    graph.index.reserve(edges.size());
+
+    QVector<int> degree;
+    QVector<QPair<int, int>> dense;
+    dense.reserve(edges.size());
+
+    for (const QPair<int, int> &edge : edges) {
+        if (edge.first == edge.second) {
+            continue;
+        }
+
+        int endpoints[2] = { edge.first, edge.second };
+        int mapped[2];
+        for (int i = 0; i < 2; ++i) {
+            auto it = graph.index.constFind(endpoints[i]);
+            if (it == graph.index.constEnd()) {
+                it = graph.index.insert(endpoints[i], graph.ids.size());
+                graph.ids.append(endpoints[i]);
+                degree.append(0);
+            }
+            mapped[i] = it.value();
+        }
+
+        ++degree[mapped[0]];
+        ++degree[mapped[1]];
+        dense.append(qMakePair(mapped[0], mapped[1]));
+    }
+
+    graph.offsets.resize(graph.ids.size() + 1);
+    graph.offsets[0] = 0;
+    for (int i = 0; i < graph.ids.size(); ++i) {
+        graph.offsets[i + 1] = graph.offsets[i] + degree[i];
+    }
+
+    graph.targets.resize(graph.offsets.last());
+    QVector<int> cursor = graph.offsets;
+    for (const QPair<int, int> &edge : dense) {
+        graph.targets[cursor[edge.first]++] = edge.second;
+        graph.targets[cursor[edge.second]++] = edge.first;
+    }
+
+    return graph;
+}
+
+QVector<int> ConnectionGraph::neighbors(int id) const {
+    return neighborhood(id, 1);
+}
+
+QVector<int> ConnectionGraph::reachable(int id) const {
+    return neighborhood(id, -1);
+}
+
+QVector<int> ConnectionGraph::neighborhood(int id, int hops) const {
+    auto it = index.constFind(id);
+    if (it == index.constEnd()) {
+        return QVector<int>{ id };
+    }
+
+    // Breadth-first search; hops < 0 means unbounded.
+    QVector<int> depth(ids.size(), -1);
+    QVector<int> queue;
+    queue.reserve(64);
+    queue.append(it.value());
+    depth[it.value()] = 0;
+
+    for (int head = 0; head < queue.size(); ++head) {
+        const int node = queue.at(head);
+        if (hops >= 0 && depth.at(node) >= hops) {
+            continue;
+        }
+        for (int e = offsets.at(node); e < offsets.at(node + 1); ++e) {
+            const int next = targets.at(e);
+            if (depth.at(next) < 0) {
+                depth[next] = depth.at(node) + 1;
+                queue.append(next);
+            }
+        }
+    }
+
+    QVector<int> result(queue.size());
+    for (int i = 0; i < queue.size(); ++i) {
+        result[i] = ids.at(queue.at(i));
+    }
+    return result;
+}
+
+QVector<int> ConnectionGraph::depthFirst(int id) const {
+    auto it = index.constFind(id);
+    if (it == index.constEnd()) {
+        return QVector<int>{ id };
+    }
+
+    QVector<bool> visited(ids.size(), false);
+    QVector<int> stack;
+    QVector<int> result;
+    stack.append(it.value());
+
+    while (!stack.isEmpty()) {
+        const int node = stack.takeLast();
+        if (visited.at(node)) {
+            continue;
+        }
+        visited[node] = true;
+        result.append(ids.at(node));
+
+        for (int e = offsets.at(node + 1) - 1; e >= offsets.at(node); --e) {
+            if (!visited.at(targets.at(e))) {
+                stack.append(targets.at(e));
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,34 @@
+#ifndef CONNECTIONGRAPH_H
+#define CONNECTIONGRAPH_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+// Immutable undirected adjacency snapshot in compressed sparse row form:
+// the neighbours of dense node i are targets[offsets[i] .. offsets[i + 1]).
+// Queries take and return figure ids; it is safe to query one snapshot
+// from several threads.
+class ConnectionGraph {
+public:
+    ConnectionGraph() = default;
+
+    static ConnectionGraph build(const QVector<QPair<int, int>> &edges);
+
+    int nodeCount() const { return ids.size(); }
+    int edgeCount() const { return targets.size() / 2; }
+    bool contains(int id) const { return index.contains(id); }
+
+    QVector<int> neighbors(int id) const;
+    QVector<int> reachable(int id) const;
+    QVector<int> depthFirst(int id) const;
+    QVector<int> neighborhood(int id, int hops) const;
+
+private:
+    QHash<int, int> index;
+    QVector<int> ids;
+    QVector<int> offsets;
+    QVector<int> targets;
+};
+
+#endif // CONNECTIONGRAPH_H
@@ -0,0 +1,15 @@
+QT += sql concurrent
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+# Links the core library built by core.pro; the top-level labs.pro builds
+# it before the apps.
+win32:CONFIG(release, debug|release): CORE_LIBDIR = $$OUT_PWD/../core/release
+else:win32:CONFIG(debug, debug|release): CORE_LIBDIR = $$OUT_PWD/../core/debug
+else: CORE_LIBDIR = $$OUT_PWD/../core
+
+LIBS += -L$$CORE_LIBDIR -lcore
+
+win32-g++|!win32: PRE_TARGETDEPS += $$CORE_LIBDIR/libcore.a
+else: PRE_TARGETDEPS += $$CORE_LIBDIR/core.lib
@@ -0,0 +1,47 @@
+# Headless core shared by both apps: node and edge stores, the figures
+# persistence, graph queries, layout and autosave. Built as a static
+# library so it can be linked into a benchmark or a server without any
+# widgets; the apps pick it up through core.pri.
+
+TEMPLATE = lib
+TARGET = core
+CONFIG += staticlib c++11
+
+QT += sql concurrent
+QT -= widgets
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    geometrycache.cpp \
+    connectiongraph.cpp \
+    spatialgrid.cpp \
+    perfstats.cpp \
+    sqlexecutor.cpp \
+    figurestore.cpp \
+    idallocator.cpp \
+    scriptrunner.cpp \
+    nodestore.cpp \
+    edgekernel.cpp \
+    forcelayout.cpp \
+    nodelayout.cpp \
+    changejournal.cpp
+
+HEADERS += \
+    geometrycache.h \
+    connectiongraph.h \
+    spatialgrid.h \
+    perfstats.h \
+    sqlexecutor.h \
+    figurestore.h \
+    idallocator.h \
+    scriptrunner.h \
+    nodestore.h \
+    objectpool.h \
+    processmemory.h \
+    edgekernel.h \
+    parallelfor.h \
+    forcelayout.h \
+    nodelayout.h \
+    changejournal.h \
+    figurekind.h
@@ -0,0 +1,49 @@
+#include "edgekernel.h"
+#include "perfstats.h"
+#include "parallelfor.h"
+
+EdgeKernel::EdgeKernel(const QVector<Anchor> &anchors) {
+    for (int kind = 0; kind < 4; ++kind) {
+        anchorX[kind] = kind < anchors.size() ? anchors.at(kind).x : 0;
+        anchorY[kind] = kind < anchors.size() ? anchors.at(kind).y : 0;
+    }
+}
+
+void EdgeKernel::compute(const NodeStore &nodes, const QVector<qint32> &from, const QVector<qint32> &to,
+                         Endpoints &result) {
+    static const int category = PerfStats::instance().category("EdgeKernel::compute");
+    PerfTimer timer(category);
+
+    const int count = qMin(from.size(), to.size());
+    result.x1.resize(count);
+    result.y1.resize(count);
+    result.x2.resize(count);
+    result.y2.resize(count);
+
+    const float *ax = anchorX;
+    const float *ay = anchorY;
+    const FigureKind *kinds = nodes.kinds().constData();
+    const float *xs = nodes.xs().constData();
+    const float *ys = nodes.ys().constData();
+    const float *widths = nodes.widths().constData();
+    const float *heights = nodes.heights().constData();
+    const qint32 *a = from.constData();
+    const qint32 *b = to.constData();
+    float *x1 = result.x1.data();
+    float *y1 = result.y1.data();
+    float *x2 = result.x2.data();
+    float *y2 = result.y2.data();
+
+    parallelFor(count, ChunkSize, [=](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const int s = a[i];
+            const int t = b[i];
+            const int sKind = qMin(int(kinds[s]), 3);
+            const int tKind = qMin(int(kinds[t]), 3);
+            x1[i] = xs[s] + ax[sKind] * widths[s];
+            y1[i] = ys[s] + ay[sKind] * heights[s];
+            x2[i] = xs[t] + ax[tKind] * widths[t];
+            y2[i] = ys[t] + ay[tKind] * heights[t];
+        }
+    });
+}
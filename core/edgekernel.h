@@ -0,0 +1,44 @@
+#ifndef EDGEKERNEL_H
+#define EDGEKERNEL_H
+
+#include <QVector>
+#include "nodestore.h"
+
+// Recomputes line endpoints for many edges at once. Each endpoint is
+// gathered straight from the node store's flat arrays for the slots the
+// batch references, so the cost follows the batch rather than the store,
+// and endpoints are produced as four parallel float arrays. Batches above ChunkSize are split into chunks
+// and run on the global thread pool; nothing here touches scene items,
+// so the caller applies the result on the GUI thread.
+class EdgeKernel {
+public:
+    enum { ChunkSize = 8192 };
+
+    // Offset from a node's position to its centre, as a fraction of its
+    // width and height, per FigureKind.
+    struct Anchor {
+        float x;
+        float y;
+    };
+
+    struct Endpoints {
+        QVector<float> x1;
+        QVector<float> y1;
+        QVector<float> x2;
+        QVector<float> y2;
+    };
+
+    explicit EdgeKernel(const QVector<Anchor> &anchors);
+
+    // Edges are pairs of node slots; from and to must have equal length.
+    void compute(const NodeStore &nodes, const QVector<qint32> &from, const QVector<qint32> &to,
+                 Endpoints &result);
+
+private:
+    // Anchors per kind as two flat tables; unknown kinds map to the
+    // position itself.
+    float anchorX[4];
+    float anchorY[4];
+};
+
+#endif // EDGEKERNEL_H
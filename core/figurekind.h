@@ -0,0 +1,29 @@
+#ifndef FIGUREKIND_H
+#define FIGUREKIND_H
+
+#include <QString>
+
+enum class FigureKind : quint8 {
+    Rectangle,
+    Ellipse,
+    Polygon,
+    Unknown
+};
+
+inline FigureKind figureKindFromName(const QString &name) {
+    if (name.compare(QLatin1String("rectangle"), Qt::CaseInsensitive) == 0) return FigureKind::Rectangle;
+    if (name.compare(QLatin1String("ellipse"), Qt::CaseInsensitive) == 0) return FigureKind::Ellipse;
+    if (name.compare(QLatin1String("polygon"), Qt::CaseInsensitive) == 0) return FigureKind::Polygon;
+    return FigureKind::Unknown;
+}
+
+inline QString figureKindName(FigureKind kind) {
+    switch (kind) {
+    case FigureKind::Rectangle: return QStringLiteral("rectangle");
+    case FigureKind::Ellipse: return QStringLiteral("ellipse");
+    case FigureKind::Polygon: return QStringLiteral("polygon");
+    default: return QString();
+    }
+}
+
+#endif // FIGUREKIND_H
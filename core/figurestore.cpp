@@ -0,0 +1,356 @@
+#include "figurestore.h"
+#include "sqlexecutor.h"
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariantList>
+
+FigureStore::FigureStore(const QString &connectionName)
+    : connectionName(connectionName) {}
+
+QSqlDatabase FigureStore::database() const {
+    return QSqlDatabase::database(connectionName);
+}
+
+bool FigureStore::fail(const QString &message) {
+    error = message;
+    return false;
+}
+
+bool FigureStore::createSchema() {
+    QSqlQuery query(database());
+
+    if (!SqlExecutor::exec(query, "CREATE TABLE IF NOT EXISTS figures ("
+                                  "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                  "type TEXT, "
+                                  "related_ids TEXT, type_count INTEGER, "
+                                  "hidden INTEGER NOT NULL DEFAULT 0)", "FigureStore::createSchema")) {
+        return fail(query.lastError().text());
+    }
+
+    // Only a small fraction of figures is hidden at any time, so a partial
+    // index keeps "which figures are hidden" cheap without indexing every row.
+    if (!SqlExecutor::exec(query, "CREATE INDEX IF NOT EXISTS figures_hidden ON figures (id) WHERE hidden = 1",
+                           "FigureStore::createSchema")
+            || !SqlExecutor::exec(query, "CREATE INDEX IF NOT EXISTS figures_type ON figures (type)",
+                                  "FigureStore::createSchema")) {
+        return fail(query.lastError().text());
+    }
+
+    // Each link is stored once with a < b. Deleting a figure cascades to its
+    // links, and related_ids is derived from this table.
+    if (!SqlExecutor::exec(query, "PRAGMA foreign_keys = ON", "FigureStore::createSchema")
+            || !SqlExecutor::exec(query, "CREATE TABLE IF NOT EXISTS links ("
+                                         "a INTEGER NOT NULL REFERENCES figures (id) ON DELETE CASCADE, "
+                                         "b INTEGER NOT NULL REFERENCES figures (id) ON DELETE CASCADE, "
+                                         "PRIMARY KEY (a, b))", "FigureStore::createSchema")
+            || !SqlExecutor::exec(query, "CREATE INDEX IF NOT EXISTS links_b ON links (b)", "FigureStore::createSchema")) {
+        return fail(query.lastError().text());
+    }
+
+    return true;
+}
+
+bool FigureStore::insertFigure(int id, FigureKind kind) {
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        return fail(db.lastError().text());
+    }
+
+    const char *site = "FigureStore::insertFigure";
+    const QString type = figureKindName(kind);
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO figures (id, type, related_ids, type_count) VALUES (?, ?, '', 0)");
+    query.addBindValue(id);
+    query.addBindValue(type);
+    if (!SqlExecutor::exec(query, site)) {
+        db.rollback();
+        return fail(query.lastError().text());
+    }
+
+    if (!updateTypeCounts(QStringList() << type, site)) {
+        db.rollback();
+        return false;
+    }
+
+    if (!db.commit()) {
+        return fail(db.lastError().text());
+    }
+    return true;
+}
+
+bool FigureStore::link(const QVector<QPair<int, int>> &pairs) {
+    return updateLinks(pairs, "INSERT OR IGNORE INTO links (a, b) SELECT a, b FROM batch_links", "FigureStore::link");
+}
+
+bool FigureStore::unlink(const QVector<QPair<int, int>> &pairs) {
+    return updateLinks(pairs, "DELETE FROM links WHERE rowid IN ("
+                              "SELECT links.rowid FROM batch_links JOIN links USING (a, b))", "FigureStore::unlink");
+}
+
+// Stages the pairs, applies statement to the links table and rebuilds
+// related_ids of every figure touched, all in one transaction.
+bool FigureStore::updateLinks(const QVector<QPair<int, int>> &pairs, const QString &statement, const char *site) {
+    if (pairs.isEmpty()) {
+        return true;
+    }
+
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        return fail(db.lastError().text());
+    }
+
+    if (!stagePairs(pairs, site)) {
+        db.rollback();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    if (!SqlExecutor::exec(query, statement, site)
+            || !refreshRelatedIds(query, "SELECT a FROM batch_links UNION SELECT b FROM batch_links", site)) {
+        error = query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    if (!db.commit()) {
+        return fail(db.lastError().text());
+    }
+    return true;
+}
+
+bool FigureStore::stageIds(const QString &table, const QVector<int> &ids, const char *site) {
+    QSqlQuery query(database());
+
+    if (!SqlExecutor::exec(query, "CREATE TEMP TABLE IF NOT EXISTS " + table + " (id INTEGER PRIMARY KEY)", site)
+            || !SqlExecutor::exec(query, "DELETE FROM " + table, site)) {
+        return fail(query.lastError().text());
+    }
+    if (ids.isEmpty()) {
+        return true;
+    }
+
+    QVariantList values;
+    values.reserve(ids.size());
+    for (int id : ids) {
+        values << id;
+    }
+
+    query.prepare("INSERT OR IGNORE INTO " + table + " (id) VALUES (?)");
+    query.addBindValue(values);
+    if (!SqlExecutor::execBatch(query, site)) {
+        return fail(query.lastError().text());
+    }
+    return true;
+}
+
+bool FigureStore::stagePairs(const QVector<QPair<int, int>> &pairs, const char *site) {
+    QSqlQuery query(database());
+
+    if (!SqlExecutor::exec(query, "CREATE TEMP TABLE IF NOT EXISTS batch_links (a INTEGER, b INTEGER, PRIMARY KEY (a, b))", site)
+            || !SqlExecutor::exec(query, "DELETE FROM batch_links", site)) {
+        return fail(query.lastError().text());
+    }
+
+    QVariantList first, second;
+    first.reserve(pairs.size());
+    second.reserve(pairs.size());
+    for (const QPair<int, int> &pair : pairs) {
+        first << qMin(pair.first, pair.second);
+        second << qMax(pair.first, pair.second);
+    }
+
+    query.prepare("INSERT OR IGNORE INTO batch_links (a, b) VALUES (?, ?)");
+    query.addBindValue(first);
+    query.addBindValue(second);
+    if (!SqlExecutor::execBatch(query, site)) {
+        return fail(query.lastError().text());
+    }
+    return true;
+}
+
+bool FigureStore::setHidden(const QVector<int> &ids, bool hidden) {
+    if (ids.isEmpty()) {
+        return true;
+    }
+
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        return fail(db.lastError().text());
+    }
+
+    if (!stageIds("batch_ids", ids, "FigureStore::setHidden")) {
+        db.rollback();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("UPDATE figures SET hidden = ? WHERE id IN (SELECT id FROM batch_ids)");
+    query.addBindValue(hidden ? 1 : 0);
+    if (!SqlExecutor::exec(query, "FigureStore::setHidden")) {
+        db.rollback();
+        return fail(query.lastError().text());
+    }
+
+    if (!db.commit()) {
+        return fail(db.lastError().text());
+    }
+    return true;
+}
+
+QVector<int> FigureStore::hiddenIds() {
+    QVector<int> ids;
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    if (!SqlExecutor::exec(query, "SELECT id FROM figures WHERE hidden = 1", "FigureStore::hiddenIds")) {
+        fail(query.lastError().text());
+        return ids;
+    }
+
+    while (query.next()) {
+        ids.append(query.value(0).toInt());
+    }
+    return ids;
+}
+
+bool FigureStore::deleteFigures(const QVector<int> &ids) {
+    if (ids.isEmpty()) {
+        return true;
+    }
+
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        return fail(db.lastError().text());
+    }
+
+    const char *site = "FigureStore::deleteFigures";
+    QSqlQuery query(db);
+    QStringList types;
+
+    // Neighbours have to be collected before the cascade removes the links
+    // that lead to them.
+    bool ok = stageIds("batch_ids", ids, site) && stageIds("affected_ids", QVector<int>(), site);
+    if (ok) {
+        ok = SqlExecutor::exec(query, "INSERT OR IGNORE INTO affected_ids (id) "
+                                      "SELECT b FROM links WHERE a IN (SELECT id FROM batch_ids) "
+                                      "UNION SELECT a FROM links WHERE b IN (SELECT id FROM batch_ids)", site)
+             && SqlExecutor::exec(query, "SELECT DISTINCT type FROM figures WHERE id IN (SELECT id FROM batch_ids)", site);
+    }
+    if (ok) {
+        while (query.next()) {
+            types << query.value(0).toString();
+        }
+        ok = SqlExecutor::exec(query, "DELETE FROM figures WHERE id IN (SELECT id FROM batch_ids)", site)
+             && refreshRelatedIds(query, "SELECT id FROM affected_ids", site);
+    }
+    if (!ok) {
+        error = query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    if (!updateTypeCounts(types, site)) {
+        db.rollback();
+        return false;
+    }
+
+    if (!db.commit()) {
+        return fail(db.lastError().text());
+    }
+    return true;
+}
+
+bool FigureStore::restore(const ChangeJournal::State &state) {
+    if (state.nodes.isEmpty()) {
+        return true;
+    }
+
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        return fail(db.lastError().text());
+    }
+
+    const char *site = "FigureStore::restore";
+    QVariantList ids, types, hidden;
+    QStringList distinctTypes;
+    ids.reserve(state.nodes.size());
+    types.reserve(state.nodes.size());
+    hidden.reserve(state.nodes.size());
+    for (auto it = state.nodes.constBegin(); it != state.nodes.constEnd(); ++it) {
+        const QString type = figureKindName(it.value().kind);
+        ids << it.key();
+        types << type;
+        hidden << (it.value().hidden ? 1 : 0);
+        if (!distinctTypes.contains(type)) {
+            distinctTypes << type;
+        }
+    }
+
+    QVariantList first, second;
+    first.reserve(state.links.size());
+    second.reserve(state.links.size());
+    for (quint64 key : state.links) {
+        const QPair<int, int> link = ChangeJournal::State::linkIds(key);
+        first << link.first;
+        second << link.second;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO figures (id, type, related_ids, type_count, hidden) VALUES (?, ?, '', 0, ?)");
+    query.addBindValue(ids);
+    query.addBindValue(types);
+    query.addBindValue(hidden);
+    bool ok = SqlExecutor::execBatch(query, site);
+    if (ok && !first.isEmpty()) {
+        query.prepare("INSERT OR IGNORE INTO links (a, b) VALUES (?, ?)");
+        query.addBindValue(first);
+        query.addBindValue(second);
+        ok = SqlExecutor::execBatch(query, site)
+             && refreshRelatedIds(query, "SELECT a FROM links UNION SELECT b FROM links", site);
+    }
+    if (!ok) {
+        error = query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    if (!updateTypeCounts(distinctTypes, site)) {
+        db.rollback();
+        return false;
+    }
+
+    if (!db.commit()) {
+        return fail(db.lastError().text());
+    }
+    return true;
+}
+
+bool FigureStore::updateTypeCounts(const QStringList &types, const char *site) {
+    QSqlQuery count(database());
+    QSqlQuery update(database());
+    update.prepare("UPDATE figures SET type_count = ? WHERE type = ?");
+
+    for (const QString &type : types) {
+        count.prepare("SELECT COUNT(*) FROM figures WHERE type = ?");
+        count.addBindValue(type);
+        if (!SqlExecutor::exec(count, site) || !count.next()) {
+            return fail(count.lastError().text());
+        }
+
+        update.addBindValue(count.value(0).toInt());
+        update.addBindValue(type);
+        if (!SqlExecutor::exec(update, site)) {
+            return fail(update.lastError().text());
+        }
+    }
+    return true;
+}
+
+// related_ids is a denormalized copy of the links table; idSet is a SELECT
+// (or VALUES list) naming the figures whose copy has to be rebuilt.
+bool FigureStore::refreshRelatedIds(QSqlQuery &query, const QString &idSet, const char *site) {
+    return SqlExecutor::exec(query, "UPDATE figures SET related_ids = COALESCE(("
+                                    "SELECT group_concat(other) FROM ("
+                                    "SELECT b AS other FROM links WHERE a = figures.id "
+                                    "UNION ALL SELECT a FROM links WHERE b = figures.id)), '') "
+                                    "WHERE id IN (" + idSet + ")", site);
+}
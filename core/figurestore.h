@@ -0,0 +1,49 @@
+#ifndef FIGURESTORE_H
+#define FIGURESTORE_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QPair>
+#include <QVector>
+#include "changejournal.h"
+
+// Persistence for the figures table. Set-based operations stage their id
+// lists in a temporary table and touch the figures table with a single
+// statement inside one transaction.
+class FigureStore {
+public:
+    explicit FigureStore(const QString &connectionName = QLatin1String(QSqlDatabase::defaultConnection));
+
+    bool createSchema();
+
+    bool insertFigure(int id, FigureKind kind);
+
+    // Pairs are stored as given; callers filter out self-links, duplicates
+    // and unknown ids beforehand (CustomScene::connectFigures does).
+    bool link(const QVector<QPair<int, int>> &pairs);
+    bool unlink(const QVector<QPair<int, int>> &pairs);
+
+    bool setHidden(const QVector<int> &ids, bool hidden);
+    QVector<int> hiddenIds();
+
+    bool deleteFigures(const QVector<int> &ids);
+    bool restore(const ChangeJournal::State &state);
+
+    QString lastError() const { return error; }
+
+private:
+    QSqlDatabase database() const;
+    bool stageIds(const QString &table, const QVector<int> &ids, const char *site);
+    bool stagePairs(const QVector<QPair<int, int>> &pairs, const char *site);
+    bool updateLinks(const QVector<QPair<int, int>> &pairs, const QString &statement, const char *site);
+    bool updateTypeCounts(const QStringList &types, const char *site);
+    bool refreshRelatedIds(QSqlQuery &query, const QString &idSet, const char *site);
+    bool fail(const QString &message);
+
+    QString connectionName;
+    QString error;
+};
+
+#endif // FIGURESTORE_H
@@ -0,0 +1,378 @@
+#include "forcelayout.h"
+#include "parallelfor.h"
+#include "perfstats.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutexLocker>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+enum {
+    Empty = -1,
+    Internal = -2,
+    MaxDepth = 32,
+    ChunkSize = 1024
+};
+
+// Golden-angle spiral, used to spread nodes that start on top of each other.
+QPointF spiral(int k, qreal radius) {
+    const qreal angle = k * 2.39996323;
+    const qreal r = radius * qSqrt(k + 1);
+    return QPointF(r * qCos(angle), r * qSin(angle));
+}
+
+}
+
+ForceLayout::ForceLayout(QObject *parent)
+    : QObject(parent), settings(defaultSettings()), canceled(false), pending(false) {
+    controller.setMaxThreadCount(1);
+    connect(&watcher, &QFutureWatcherBase::finished, this, &ForceLayout::onFinished);
+}
+
+ForceLayout::~ForceLayout() {
+    cancel();
+    controller.waitForDone();
+}
+
+ForceLayout::Settings ForceLayout::defaultSettings() {
+    Settings defaults;
+    defaults.maxIterations = 300;
+    defaults.springLength = 80;
+    defaults.theta = 0.9;
+    defaults.tolerance = 0.01;
+    defaults.publishInterval = 50;
+    return defaults;
+}
+
+void ForceLayout::setSettings(const Settings &newSettings) {
+    settings = newSettings;
+}
+
+bool ForceLayout::start(const QVector<int> &nodeIds, const QVector<QPointF> &positions,
+                        const QVector<quint8> &nodePinned, const QVector<QPair<int, int>> &edges) {
+    if (running) {
+        return false;
+    }
+
+    const int count = nodeIds.size();
+    QHash<int, int> index;
+    index.reserve(count);
+    ids = nodeIds;
+    xs.resize(count);
+    ys.resize(count);
+    pinned = nodePinned;
+    pinned.resize(count);
+    movable.resize(0);
+    for (int i = 0; i < count; ++i) {
+        index.insert(ids.at(i), i);
+        xs[i] = float(positions.at(i).x());
+        ys[i] = float(positions.at(i).y());
+        if (!pinned.at(i)) {
+            movable.append(i);
+        }
+    }
+    if (movable.isEmpty()) {
+        return false;
+    }
+
+    // Undirected adjacency in CSR form, so each node sums its own spring
+    // forces without writing to anyone else's.
+    QVector<int> degree(count + 1, 0);
+    QVector<QPair<int, int>> local;
+    local.reserve(edges.size());
+    for (const QPair<int, int> &edge : edges) {
+        const int a = index.value(edge.first, -1);
+        const int b = index.value(edge.second, -1);
+        if (a >= 0 && b >= 0 && a != b) {
+            local.append(qMakePair(a, b));
+            ++degree[a + 1];
+            ++degree[b + 1];
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        degree[i + 1] += degree[i];
+    }
+    offsets = degree;
+    neighbours.resize(local.size() * 2);
+    for (const QPair<int, int> &edge : local) {
+        neighbours[degree[edge.first]++] = edge.second;
+        neighbours[degree[edge.second]++] = edge.first;
+    }
+
+    // A new node starts next to the pinned nodes it is linked to; nodes
+    // with no placed neighbour fan out around where they already are.
+    const qreal spacing = settings.springLength / 2;
+    for (int k = 0; k < movable.size(); ++k) {
+        const int i = movable.at(k);
+        float sumX = 0;
+        float sumY = 0;
+        int placed = 0;
+        for (int e = offsets.at(i); e < offsets.at(i + 1); ++e) {
+            const int j = neighbours.at(e);
+            if (pinned.at(j)) {
+                sumX += xs.at(j);
+                sumY += ys.at(j);
+                ++placed;
+            }
+        }
+        const QPointF offset = placed > 0 ? spiral(k % 16, spacing) : spiral(k, spacing);
+        if (placed > 0) {
+            xs[i] = sumX / placed + float(offset.x());
+            ys[i] = sumY / placed + float(offset.y());
+        } else {
+            xs[i] += float(offset.x());
+            ys[i] += float(offset.y());
+        }
+    }
+
+    {
+        QMutexLocker locker(&snapshotMutex);
+        snapshotIds.resize(0);
+        for (int i : movable) {
+            snapshotIds.append(ids.at(i));
+        }
+    }
+
+    canceled = false;
+    running = true;
+    watcher.setFuture(QtConcurrent::run(&controller, [this]() { return run(); }));
+    return true;
+}
+
+void ForceLayout::cancel() {
+    canceled = true;
+}
+
+int ForceLayout::run() {
+    static const int category = PerfStats::instance().category("ForceLayout::iteration");
+
+    const int count = movable.size();
+    const float k = float(settings.springLength);
+    float temperature = k * qSqrt(qreal(count)) / 10;
+    const float floor = k / 100;
+    const float cooling = (temperature - floor) / qMax(1, settings.maxIterations);
+    dx.resize(count);
+    dy.resize(count);
+
+    QElapsedTimer sincePublish;
+    sincePublish.start();
+    int iteration = 0;
+    while (iteration < settings.maxIterations && !canceled) {
+        PerfTimer timer(category);
+        buildTree();
+
+        const int *movableData = movable.constData();
+        const int *offsetData = offsets.constData();
+        const int *neighbourData = neighbours.constData();
+        const float *x = xs.constData();
+        const float *y = ys.constData();
+        float *outX = dx.data();
+        float *outY = dy.data();
+        parallelFor(count, ChunkSize, [=](int begin, int end) {
+            for (int m = begin; m < end; ++m) {
+                const int i = movableData[m];
+                float fx = 0;
+                float fy = 0;
+                repulse(i, fx, fy);
+                for (int e = offsetData[i]; e < offsetData[i + 1]; ++e) {
+                    const int j = neighbourData[e];
+                    const float ddx = x[i] - x[j];
+                    const float ddy = y[i] - y[j];
+                    const float d = std::sqrt(ddx * ddx + ddy * ddy);
+                    fx -= ddx * d / k;
+                    fy -= ddy * d / k;
+                }
+                outX[m] = fx;
+                outY[m] = fy;
+            }
+        });
+
+        float largest = 0;
+        for (int m = 0; m < count; ++m) {
+            const float length = std::sqrt(dx.at(m) * dx.at(m) + dy.at(m) * dy.at(m));
+            if (length > 0) {
+                const float step = qMin(length, temperature);
+                xs[movable.at(m)] += dx.at(m) / length * step;
+                ys[movable.at(m)] += dy.at(m) / length * step;
+                largest = qMax(largest, step);
+            }
+        }
+        temperature = qMax(floor, temperature - cooling);
+        ++iteration;
+
+        if (sincePublish.elapsed() >= settings.publishInterval) {
+            publish();
+            sincePublish.restart();
+        }
+        if (iteration > 10 && largest < settings.tolerance * k) {
+            break;
+        }
+    }
+
+    publish();
+    return iteration;
+}
+
+void ForceLayout::buildTree() {
+    float minX = std::numeric_limits<float>::max();
+    float minY = minX;
+    float maxX = -minX;
+    float maxY = -minX;
+    for (int i = 0; i < xs.size(); ++i) {
+        minX = qMin(minX, xs.at(i));
+        minY = qMin(minY, ys.at(i));
+        maxX = qMax(maxX, xs.at(i));
+        maxY = qMax(maxY, ys.at(i));
+    }
+
+    cells.resize(0);
+    cells.reserve(xs.size() * 2);
+    Cell root = { (minX + maxX) / 2, (minY + maxY) / 2, qMax(maxX - minX, maxY - minY) / 2 + 1,
+                  0, 0, 0, { -1, -1, -1, -1 }, Empty };
+    cells.append(root);
+    for (int i = 0; i < xs.size(); ++i) {
+        insert(0, i, 0);
+    }
+
+    // Children are always appended after their parent, so one backwards
+    // sweep sums every subtree before its parent is visited.
+    for (int c = cells.size() - 1; c >= 0; --c) {
+        Cell &cell = cells[c];
+        if (cell.body != Internal) {
+            continue;
+        }
+        cell.mass = cell.massX = cell.massY = 0;
+        for (int q = 0; q < 4; ++q) {
+            if (cell.child[q] >= 0) {
+                const Cell &child = cells.at(cell.child[q]);
+                cell.mass += child.mass;
+                cell.massX += child.massX;
+                cell.massY += child.massY;
+            }
+        }
+    }
+}
+
+void ForceLayout::insert(int cell, int body, int depth) {
+    const float x = xs.at(body);
+    const float y = ys.at(body);
+
+    while (true) {
+        if (cells.at(cell).body == Empty) {
+            Cell &leaf = cells[cell];
+            leaf.body = body;
+            leaf.mass = 1;
+            leaf.massX = x;
+            leaf.massY = y;
+            return;
+        }
+
+        if (cells.at(cell).body >= 0) {
+            Cell &leaf = cells[cell];
+            if (depth >= MaxDepth) {
+                // Coincident nodes share one leaf.
+                leaf.mass += 1;
+                leaf.massX += x;
+                leaf.massY += y;
+                return;
+            }
+
+            // Push the resident body one level down and fall through to
+            // the internal-node case.
+            const int resident = leaf.body;
+            leaf.body = Internal;
+            const Cell parent = leaf;
+            const int q = (xs.at(resident) >= parent.cx ? 1 : 0) + (ys.at(resident) >= parent.cy ? 2 : 0);
+            const float half = parent.half / 2;
+            Cell child = { parent.cx + ((q & 1) ? half : -half), parent.cy + ((q & 2) ? half : -half), half,
+                           parent.mass, parent.massX, parent.massY, { -1, -1, -1, -1 }, resident };
+            cells[cell].child[q] = cells.size();
+            cells.append(child);
+        }
+
+        const Cell parent = cells.at(cell);
+        const int q = (x >= parent.cx ? 1 : 0) + (y >= parent.cy ? 2 : 0);
+        if (parent.child[q] < 0) {
+            const float half = parent.half / 2;
+            Cell child = { parent.cx + ((q & 1) ? half : -half), parent.cy + ((q & 2) ? half : -half), half,
+                           0, 0, 0, { -1, -1, -1, -1 }, Empty };
+            cells[cell].child[q] = cells.size();
+            cells.append(child);
+        }
+        cell = cells.at(cell).child[q];
+        ++depth;
+    }
+}
+
+void ForceLayout::repulse(int body, float &fx, float &fy) const {
+    const float x = xs.at(body);
+    const float y = ys.at(body);
+    const float k2 = float(settings.springLength * settings.springLength);
+    const float theta2 = float(settings.theta * settings.theta);
+
+    int stack[4 * MaxDepth + 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Cell &cell = cells.at(stack[--top]);
+        if (cell.mass == 0 || (cell.body == body && cell.mass == 1)) {
+            continue;
+        }
+
+        const float ddx = x - cell.massX / cell.mass;
+        const float ddy = y - cell.massY / cell.mass;
+        const float d2 = ddx * ddx + ddy * ddy;
+        const float size = 2 * cell.half;
+        if (cell.body != Internal || size * size < theta2 * d2) {
+            if (d2 > 1e-4f) {
+                const float f = k2 * cell.mass / d2;
+                fx += ddx * f;
+                fy += ddy * f;
+            }
+            continue;
+        }
+
+        for (int q = 0; q < 4; ++q) {
+            if (cell.child[q] >= 0) {
+                stack[top++] = cell.child[q];
+            }
+        }
+    }
+}
+
+void ForceLayout::publish() {
+    {
+        QMutexLocker locker(&snapshotMutex);
+        snapshot.resize(movable.size());
+        for (int m = 0; m < movable.size(); ++m) {
+            snapshot[m] = QPointF(xs.at(movable.at(m)), ys.at(movable.at(m)));
+        }
+    }
+
+    // At most one delivery is queued at a time; a slow GUI thread gets the
+    // newest snapshot instead of a backlog.
+    if (!pending.exchange(true)) {
+        QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection);
+    }
+}
+
+void ForceLayout::deliver() {
+    pending = false;
+    QVector<int> deliveredIds;
+    QVector<QPointF> positions;
+    {
+        QMutexLocker locker(&snapshotMutex);
+        deliveredIds = snapshotIds;
+        positions = snapshot;
+    }
+    emit positionsUpdated(deliveredIds, positions);
+}
+
+void ForceLayout::onFinished() {
+    running = false;
+    emit finished(watcher.result(), canceled);
+}
@@ -0,0 +1,98 @@
+#ifndef FORCELAYOUT_H
+#define FORCELAYOUT_H
+
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QPointF>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+
+// Fruchterman-Reingold layout with Barnes-Hut repulsion: each iteration
+// builds a quadtree over the current positions and approximates far-away
+// groups of nodes by their centre of mass, so one step is O(n log n).
+// The iteration loop runs on a private one-thread pool and spreads the
+// per-node force pass over the global pool; the GUI thread only receives
+// position snapshots, at most one per publishInterval milliseconds.
+//
+// Pinned nodes push and pull on the others but never move, which is how
+// only newly added nodes are laid out around an existing arrangement.
+class ForceLayout : public QObject {
+    Q_OBJECT
+
+public:
+    struct Settings {
+        int maxIterations;
+        qreal springLength;
+        qreal theta;
+        qreal tolerance;
+        int publishInterval;
+    };
+
+    explicit ForceLayout(QObject *parent = nullptr);
+    ~ForceLayout() override;
+
+    static Settings defaultSettings();
+    void setSettings(const Settings &settings);
+
+    // Positions and pinned are indexed like ids; edges hold ids. Returns
+    // false if a layout is already running or nothing would move.
+    bool start(const QVector<int> &ids, const QVector<QPointF> &positions,
+               const QVector<quint8> &pinned, const QVector<QPair<int, int>> &edges);
+    void cancel();
+    bool isRunning() const { return running; }
+
+signals:
+    // Ids and positions of the movable nodes only.
+    void positionsUpdated(const QVector<int> &ids, const QVector<QPointF> &positions);
+    void finished(int iterations, bool canceled);
+
+private slots:
+    void deliver();
+    void onFinished();
+
+private:
+    struct Cell {
+        float cx;
+        float cy;
+        float half;
+        float mass;
+        float massX;
+        float massY;
+        int child[4];
+        int body;
+    };
+
+    int run();
+    void buildTree();
+    void insert(int cell, int body, int depth);
+    void repulse(int body, float &fx, float &fy) const;
+    void publish();
+
+    Settings settings;
+    QThreadPool controller;
+    QFutureWatcher<int> watcher;
+    std::atomic<bool> canceled;
+    std::atomic<bool> pending;
+    bool running = false;
+
+    // Worker state, owned by the iteration loop while it runs.
+    QVector<int> ids;
+    QVector<float> xs;
+    QVector<float> ys;
+    QVector<quint8> pinned;
+    QVector<int> movable;
+    QVector<int> offsets;
+    QVector<int> neighbours;
+    QVector<float> dx;
+    QVector<float> dy;
+    QVector<Cell> cells;
+
+    mutable QMutex snapshotMutex;
+    QVector<int> snapshotIds;
+    QVector<QPointF> snapshot;
+};
+
+#endif // FORCELAYOUT_H
@@ -0,0 +1,150 @@
+#include "geometrycache.h"
+#include <QMutexLocker>
+#include <QtMath>
+#include <cmath>
+
+uint qHash(const GeometryCache::Key &key, uint seed) {
+    seed ^= ::qHash(key.kind, seed) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= ::qHash(key.sides, seed) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= ::qHash(key.rect.x(), seed) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= ::qHash(key.rect.y(), seed) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= ::qHash(key.rect.width(), seed) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= ::qHash(key.rect.height(), seed) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= ::qHash(key.detail, seed) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+GeometryCache &GeometryCache::instance() {
+    static GeometryCache cache;
+    return cache;
+}
+
+QVector<QPointF> GeometryCache::unitCircleLocked(int sides) {
+    if (const QVector<QPointF> *cached = unitTables.object(sides)) {
+        return *cached;
+    }
+
+    QVector<QPointF> table(sides);
+    for (int i = 0; i < sides; ++i) {
+        qreal angle = (2 * M_PI * i) / sides;
+        table[i] = QPointF(qCos(angle), qSin(angle));
+    }
+    // A table over the whole budget is not kept, but is still returned.
+    const qint64 bytes = qint64(sides) * sizeof(QPointF);
+    unitTables.insert(sides, new QVector<QPointF>(table), int(qBound<qint64>(1, bytes, MaxTableBytes + 1)));
+    return table;
+}
+
+QVector<QPointF> GeometryCache::unitCircle(int sides) {
+    QMutexLocker locker(&mutex);
+    return unitCircleLocked(sides);
+}
+
+GeometryCache::Entry GeometryCache::entry(const Key &key) {
+    if (const Entry *cached = entries.object(key)) {
+        ++hits;
+        return *cached;
+    }
+
+    ++misses;
+    Entry created;
+
+    if (key.kind == RegularPolygon) {
+        const QVector<QPointF> unit = unitCircleLocked(key.sides);
+        const qreal radius = key.rect.width() / 2;
+        created.polygon.reserve(unit.size());
+        for (const QPointF &point : unit) {
+            created.polygon << point * radius;
+        }
+        created.path.addPolygon(created.polygon);
+        created.path.closeSubpath();
+    } else if (key.kind == SimplifiedPolygon) {
+        // Every (sides / detail)-th vertex of the full polygon; all of them
+        // lie on the same circle, so the result is a near-regular polygon.
+        // Only the kept vertices are computed; the full unit table of a
+        // polygon with millions of sides is never built.
+        const qreal radius = key.rect.width() / 2;
+        created.polygon.reserve(key.detail);
+        for (int i = 0; i < key.detail; ++i) {
+            const qreal angle = 2 * M_PI * (qint64(i) * key.sides / key.detail) / key.sides;
+            created.polygon << QPointF(qCos(angle), qSin(angle)) * radius;
+        }
+        created.path.addPolygon(created.polygon);
+        created.path.closeSubpath();
+    } else if (key.kind == Rectangle) {
+        created.path.addRect(key.rect);
+    } else {
+        created.path.addEllipse(key.rect);
+    }
+
+    const int cost = int(created.polygon.size() * sizeof(QPointF)
+                         + created.path.elementCount() * sizeof(QPainterPath::Element));
+    entries.insert(key, new Entry(created), qMax(1, cost));
+    return created;
+}
+
+QPolygonF GeometryCache::regularPolygon(int sides, qreal radius) {
+    QMutexLocker locker(&mutex);
+    return entry({RegularPolygon, sides, QRectF(-radius, -radius, 2 * radius, 2 * radius), 0}).polygon;
+}
+
+QPainterPath GeometryCache::polygonPath(int sides, qreal radius) {
+    QMutexLocker locker(&mutex);
+    return entry({RegularPolygon, sides, QRectF(-radius, -radius, 2 * radius, 2 * radius), 0}).path;
+}
+
+int GeometryCache::simplifiedSides(int sides, qreal pixelRadius) {
+    if (sides <= MinSimplifiedSides) {
+        return sides;
+    }
+
+    // Round the radius up to a power of two so one outline serves a range
+    // of zoom levels. A chord of a circle of radius r spanning 2*pi/n
+    // deviates from it by about r * pi^2 / (2 n^2); keeping that under a
+    // quarter pixel needs n >= pi * sqrt(2 r).
+    const qreal bucket = pixelRadius <= 1 ? 1 : qPow(2, qCeil(std::log2(pixelRadius)));
+    const int needed = qMax(int(MinSimplifiedSides), qCeil(M_PI * qSqrt(2 * bucket)));
+    return qMin(sides, needed);
+}
+
+QPainterPath GeometryCache::polygonPath(int sides, qreal radius, qreal levelOfDetail) {
+    const int drawn = simplifiedSides(sides, radius * levelOfDetail);
+    const QRectF rect(-radius, -radius, 2 * radius, 2 * radius);
+
+    QMutexLocker locker(&mutex);
+    if (drawn == sides) {
+        return entry({RegularPolygon, sides, rect, 0}).path;
+    }
+    return entry({SimplifiedPolygon, sides, rect, drawn}).path;
+}
+
+QPainterPath GeometryCache::rectPath(const QRectF &rect) {
+    QMutexLocker locker(&mutex);
+    return entry({Rectangle, 0, rect, 0}).path;
+}
+
+QPainterPath GeometryCache::ellipsePath(const QRectF &rect) {
+    QMutexLocker locker(&mutex);
+    return entry({Ellipse, 0, rect, 0}).path;
+}
+
+GeometryCache::Stats GeometryCache::stats() const {
+    QMutexLocker locker(&mutex);
+
+    Stats result;
+    result.entries = entries.size();
+    result.unitTables = unitTables.size();
+    result.hits = hits;
+    result.misses = misses;
+    result.bytes = entries.totalCost() + unitTables.totalCost();
+
+    return result;
+}
+
+void GeometryCache::clear() {
+    QMutexLocker locker(&mutex);
+    unitTables.clear();
+    entries.clear();
+    hits = 0;
+    misses = 0;
+}
@@ -0,0 +1,88 @@
+#ifndef GEOMETRYCACHE_H
+#define GEOMETRYCACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QPainterPath>
+#include <QPolygonF>
+#include <QRectF>
+#include <QVector>
+
+// Hands out implicitly shared geometry, so N identical shapes reference
+// one vertex array instead of N copies. Returned values must be treated
+// as read-only; modifying one detaches it from the cache. Entries are
+// kept up to MaxBytes of vertex data and unit tables up to MaxTableBytes,
+// both evicted least recently used first; an evicted value stays valid
+// for whoever still holds it.
+class GeometryCache {
+public:
+    enum Kind {
+        RegularPolygon,
+        Rectangle,
+        Ellipse,
+        SimplifiedPolygon
+    };
+
+    // Polygons with at most this many sides are always drawn exactly.
+    enum { MinSimplifiedSides = 16 };
+
+    enum { MaxBytes = 16 * 1024 * 1024, MaxTableBytes = 4 * 1024 * 1024 };
+
+    struct Stats {
+        int entries;
+        int unitTables;
+        qint64 bytes;
+        qint64 hits;
+        qint64 misses;
+    };
+
+    static GeometryCache &instance();
+
+    QVector<QPointF> unitCircle(int sides);
+    QPolygonF regularPolygon(int sides, qreal radius);
+    QPainterPath polygonPath(int sides, qreal radius);
+    // The outline as drawn at levelOfDetail device pixels per unit. A
+    // many-sided polygon keeps only as many of its vertices as its
+    // on-screen radius needs (the chord error stays under a quarter
+    // pixel), so the vertex count is bounded by pixel size rather than by
+    // the side count. Outlines are cached per power-of-two pixel radius;
+    // levelOfDetail 1 doubles as the hit-testing shape.
+    QPainterPath polygonPath(int sides, qreal radius, qreal levelOfDetail);
+    static int simplifiedSides(int sides, qreal pixelRadius);
+    QPainterPath rectPath(const QRectF &rect);
+    QPainterPath ellipsePath(const QRectF &rect);
+
+    Stats stats() const;
+    void clear();
+
+private:
+    struct Key {
+        int kind;
+        int sides;
+        QRectF rect;
+        int detail;
+
+        bool operator==(const Key &other) const {
+            return kind == other.kind && sides == other.sides && rect == other.rect && detail == other.detail;
+        }
+    };
+
+    struct Entry {
+        QPolygonF polygon;
+        QPainterPath path;
+    };
+
+    friend uint qHash(const Key &key, uint seed);
+
+    GeometryCache() : unitTables(MaxTableBytes), entries(MaxBytes) {}
+    Entry entry(const Key &key);
+    QVector<QPointF> unitCircleLocked(int sides);
+
+    mutable QMutex mutex;
+    QCache<int, QVector<QPointF>> unitTables;
+    QCache<Key, Entry> entries;
+    qint64 hits = 0;
+    qint64 misses = 0;
+};
+
+#endif // GEOMETRYCACHE_H
@@ -0,0 +1,155 @@
+#include "idallocator.h"
+#include "sqlexecutor.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+IdAllocator::IdAllocator(const QString &sequence, const QString &seedTable, int blockSize,
+                         const QString &connectionName)
+    : sequence(sequence), seedTable(seedTable), blockSize(blockSize), connectionName(connectionName),
+      ownerThread(QThread::currentThreadId()), state(pack(0, 0)) {
+    QSqlDatabase db = QSqlDatabase::database(connectionName, false);
+    driverName = db.driverName();
+    databaseName = db.databaseName();
+}
+
+int IdAllocator::next() {
+    qint64 current = state.load();
+    for (;;) {
+        const qint64 id = current & 0xffffffff;
+        const qint64 end = current >> 32;
+        if (id < end) {
+            if (state.compare_exchange_weak(current, pack(id + 1, end))) {
+                return int(id);
+            }
+            continue;
+        }
+
+        // Block exhausted: one thread refills, the others wait on the mutex
+        // and then retry against the new block.
+        QMutexLocker locker(&refillMutex);
+        current = state.load();
+        if ((current & 0xffffffff) < (current >> 32)) {
+            continue;
+        }
+
+        qint64 last;
+        if (!reserve(0, blockSize, &last)) {
+            qWarning() << "IdAllocator: failed to reserve ids for" << sequence << ":" << error;
+            return -1;
+        }
+        const qint64 first = last - blockSize;
+        state.store(pack(first + 1, last));
+        return int(first);
+    }
+}
+
+bool IdAllocator::skipPast(int id) {
+    QMutexLocker locker(&refillMutex);
+    qint64 current = state.load();
+    for (;;) {
+        const qint64 next = current & 0xffffffff;
+        const qint64 end = current >> 32;
+        if (id >= end) {
+            break;
+        }
+        if (id < next || state.compare_exchange_weak(current, pack(id + 1, end))) {
+            return true;
+        }
+    }
+
+    // Past the current block: the rest of it is dropped for a new block
+    // starting right after id, so a trace pinning consecutive ids only
+    // touches the database once per block.
+    qint64 last;
+    if (!reserve(qint64(id) + 1, blockSize, &last)) {
+        qWarning() << "IdAllocator: failed to skip past" << id << "in" << sequence << ":" << error;
+        return false;
+    }
+    state.store(pack(last - blockSize, last));
+    return true;
+}
+
+QString IdAllocator::lastError() const {
+    QMutexLocker locker(&refillMutex);
+    return error;
+}
+
+bool IdAllocator::reserve(qint64 floor, qint64 count, qint64 *last) {
+    if (QThread::currentThreadId() == ownerThread) {
+        return reserveOn(QSqlDatabase::database(connectionName), floor, count, last);
+    }
+
+    // Connections cannot cross threads, so a worker opens its own for the
+    // reservation and removes it again right after. With one reservation
+    // per block this is rare, and no pool thread keeps a connection alive.
+    const QString name = QString("idallocator-%1").arg(quintptr(QThread::currentThreadId()));
+    bool ok;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(driverName, name);
+        db.setDatabaseName(databaseName);
+        db.open();
+        ok = reserveOn(db, floor, count, last);
+    }
+    QSqlDatabase::removeDatabase(name);
+    return ok;
+}
+
+// Raises the sequence to at least floor, then takes count ids from it.
+// *last is the sequence's new value, one past the last id taken.
+bool IdAllocator::reserveOn(QSqlDatabase db, qint64 floor, qint64 count, qint64 *last) {
+    const char *site = "IdAllocator::reserve";
+    if (!db.isOpen()) {
+        error = db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    if (!SqlExecutor::exec(query, "CREATE TABLE IF NOT EXISTS sequences ("
+                                  "name TEXT PRIMARY KEY, next_id INTEGER NOT NULL)", site)) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    if (!db.transaction()) {
+        error = db.lastError().text();
+        return false;
+    }
+
+    // The INSERT OR IGNORE runs first and takes the write lock even when the
+    // row already exists and nothing is inserted, so the read of next_id
+    // below happens under it: concurrent reservations from other
+    // connections serialize and never hand out the same block.
+    query.prepare("INSERT OR IGNORE INTO sequences (name, next_id) "
+                  "SELECT ?, COALESCE(MAX(id), 0) + 1 FROM " + seedTable);
+    query.addBindValue(sequence);
+    bool ok = SqlExecutor::exec(query, site);
+    if (ok) {
+        query.prepare("UPDATE sequences SET next_id = MAX(next_id, ?) + ? WHERE name = ?");
+        query.addBindValue(floor);
+        query.addBindValue(count);
+        query.addBindValue(sequence);
+        ok = SqlExecutor::exec(query, site);
+    }
+    if (ok) {
+        query.prepare("SELECT next_id FROM sequences WHERE name = ?");
+        query.addBindValue(sequence);
+        ok = SqlExecutor::exec(query, site) && query.next();
+    }
+    if (!ok) {
+        error = query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    *last = query.value(0).toLongLong();
+    query.finish();
+
+    if (!db.commit()) {
+        error = db.lastError().text();
+        return false;
+    }
+    return true;
+}
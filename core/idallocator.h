@@ -0,0 +1,51 @@
+#ifndef IDALLOCATOR_H
+#define IDALLOCATOR_H
+
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+#include <atomic>
+
+// Hands out ids for a table from blocks reserved in a persisted
+// "sequences" table. Taking an id is a single compare-and-swap on the
+// current block; only the thread that exhausts a block touches the
+// database. Ids stay monotonic across restarts, unused ids of the last
+// block are simply skipped.
+class IdAllocator {
+public:
+    IdAllocator(const QString &sequence, const QString &seedTable, int blockSize = 1024,
+                const QString &connectionName = QLatin1String(QSqlDatabase::defaultConnection));
+
+    int next();
+    QString lastError() const;
+
+    // Keeps next() from ever returning id, which the caller has used
+    // without taking it from here, e.g. one pinned by a replayed trace.
+    // An id past the current block moves on to a new block after it.
+    bool skipPast(int id);
+
+    // Whether a block has been taken from the sequence yet. Ids written to
+    // the seed table after that are not seen by the sequence.
+    bool hasReserved() const { return state.load() != pack(0, 0); }
+
+private:
+    bool reserve(qint64 floor, qint64 count, qint64 *last);
+    bool reserveOn(QSqlDatabase db, qint64 floor, qint64 count, qint64 *last);
+
+    static qint64 pack(qint64 next, qint64 end) { return (end << 32) | next; }
+
+    QString sequence;
+    QString seedTable;
+    int blockSize;
+    QString connectionName;
+    QString driverName;
+    QString databaseName;
+    Qt::HANDLE ownerThread;
+
+    // Low 32 bits: next free id, high 32 bits: end of the current block.
+    std::atomic<qint64> state;
+    mutable QMutex refillMutex;
+    QString error;
+};
+
+#endif // IDALLOCATOR_H
@@ -0,0 +1,55 @@
+#include "nodelayout.h"
+
+NodeLayout::NodeLayout(NodeStore *nodes, QObject *parent)
+    : QObject(parent), nodes(nodes) {
+    connect(&layout, &ForceLayout::positionsUpdated, this, &NodeLayout::positionsUpdated);
+    connect(&layout, &ForceLayout::finished, this, &NodeLayout::onFinished);
+}
+
+bool NodeLayout::start(bool newOnly, const QVector<QPair<int, int>> &edges) {
+    if (layout.isRunning()) {
+        return false;
+    }
+
+    const int count = nodes->size();
+    QVector<QPointF> positions(count);
+    QVector<quint8> pinned(count, 0);
+    movedIds.resize(0);
+    for (int slot = 0; slot < count; ++slot) {
+        positions[slot] = nodes->positionAt(slot);
+        pinned[slot] = newOnly && nodes->testFlag(slot, NodeStore::Placed);
+        if (!pinned.at(slot)) {
+            movedIds.append(nodes->idAt(slot));
+        }
+    }
+
+    if (!layout.start(nodes->ids(), positions, pinned, edges)) {
+        movedIds.clear();
+        return false;
+    }
+    return true;
+}
+
+void NodeLayout::lastMoves(QVector<int> *ids, QVector<QPointF> *positions) const {
+    ids->resize(0);
+    positions->resize(0);
+    for (int id : movedIds) {
+        const int slot = nodes->slotOf(id);
+        if (slot >= 0) {
+            ids->append(id);
+            positions->append(nodes->positionAt(slot));
+        }
+    }
+}
+
+void NodeLayout::onFinished(int iterations, bool canceled) {
+    if (!canceled) {
+        for (int id : movedIds) {
+            const int slot = nodes->slotOf(id);
+            if (slot >= 0) {
+                nodes->setFlag(slot, NodeStore::Placed, true);
+            }
+        }
+    }
+    emit finished(iterations, canceled);
+}
@@ -0,0 +1,44 @@
+#ifndef NODELAYOUT_H
+#define NODELAYOUT_H
+
+#include <QObject>
+#include <QPair>
+#include <QPointF>
+#include <QVector>
+#include "forcelayout.h"
+#include "nodestore.h"
+
+// Runs a ForceLayout over every node in a store. When only new nodes are
+// laid out, the ones an earlier layout placed are pinned: they stay where
+// they are but still repel and attract the others. A layout that runs to
+// the end marks the nodes it moved as placed.
+class NodeLayout : public QObject {
+    Q_OBJECT
+
+public:
+    explicit NodeLayout(NodeStore *nodes, QObject *parent = nullptr);
+
+    // edges hold node ids. Returns false if a layout is already running
+    // or nothing would move.
+    bool start(bool newOnly, const QVector<QPair<int, int>> &edges);
+    void cancel() { layout.cancel(); }
+    bool isRunning() const { return layout.isRunning(); }
+
+    // The nodes the last layout moved and where they are now. Frames are
+    // streamed through positionsUpdated; this is what to record once the
+    // layout has finished.
+    void lastMoves(QVector<int> *ids, QVector<QPointF> *positions) const;
+
+signals:
+    void positionsUpdated(const QVector<int> &ids, const QVector<QPointF> &positions);
+    void finished(int iterations, bool canceled);
+
+private:
+    void onFinished(int iterations, bool canceled);
+
+    NodeStore *nodes;
+    ForceLayout layout;
+    QVector<int> movedIds;
+};
+
+#endif // NODELAYOUT_H
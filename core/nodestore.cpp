@@ -0,0 +1,95 @@
+#include "nodestore.h"
+
+int NodeStore::add(int id, FigureKind kind, const QPointF &pos, const QSizeF &size, int sides) {
+    auto it = index.constFind(id);
+    if (it != index.constEnd()) {
+        return it.value();
+    }
+
+    const int slot = nodeIds.size();
+    nodeIds.append(id);
+    nodeKinds.append(kind);
+    nodeXs.append(float(pos.x()));
+    nodeYs.append(float(pos.y()));
+    nodeWidths.append(float(size.width()));
+    nodeHeights.append(float(size.height()));
+    nodeSides.append(quint16(sides));
+    nodeFlags.append(0);
+    index.insert(id, slot);
+    return slot;
+}
+
+bool NodeStore::remove(int id) {
+    auto it = index.find(id);
+    if (it == index.end()) {
+        return false;
+    }
+
+    const int slot = it.value();
+    const int last = nodeIds.size() - 1;
+    index.erase(it);
+
+    if (slot != last) {
+        nodeIds[slot] = nodeIds.at(last);
+        nodeKinds[slot] = nodeKinds.at(last);
+        nodeXs[slot] = nodeXs.at(last);
+        nodeYs[slot] = nodeYs.at(last);
+        nodeWidths[slot] = nodeWidths.at(last);
+        nodeHeights[slot] = nodeHeights.at(last);
+        nodeSides[slot] = nodeSides.at(last);
+        nodeFlags[slot] = nodeFlags.at(last);
+        index[nodeIds.at(slot)] = slot;
+    }
+
+    nodeIds.removeLast();
+    nodeKinds.removeLast();
+    nodeXs.removeLast();
+    nodeYs.removeLast();
+    nodeWidths.removeLast();
+    nodeHeights.removeLast();
+    nodeSides.removeLast();
+    nodeFlags.removeLast();
+    return true;
+}
+
+void NodeStore::clear() {
+    nodeIds.clear();
+    nodeKinds.clear();
+    nodeXs.clear();
+    nodeYs.clear();
+    nodeWidths.clear();
+    nodeHeights.clear();
+    nodeSides.clear();
+    nodeFlags.clear();
+    index.clear();
+}
+
+void NodeStore::setPosition(int slot, const QPointF &pos) {
+    nodeXs[slot] = float(pos.x());
+    nodeYs[slot] = float(pos.y());
+}
+
+void NodeStore::setFlag(int slot, Flag flag, bool on) {
+    if (on) {
+        nodeFlags[slot] |= flag;
+    } else {
+        nodeFlags[slot] &= ~flag;
+    }
+}
+
+NodeStore::MemoryStats NodeStore::memory() const {
+    MemoryStats stats;
+    stats.nodes = nodeIds.size();
+    stats.arrayBytes = qint64(nodeIds.capacity()) * sizeof(qint32)
+                     + qint64(nodeKinds.capacity()) * sizeof(FigureKind)
+                     + qint64(nodeXs.capacity() + nodeYs.capacity() + nodeWidths.capacity() + nodeHeights.capacity()) * sizeof(float)
+                     + qint64(nodeSides.capacity()) * sizeof(quint16)
+                     + qint64(nodeFlags.capacity()) * sizeof(quint8);
+
+    // QHash keeps one bucket pointer per bucket and one heap node per entry
+    // (next pointer, hash, key, value).
+    const qint64 nodeBytes = sizeof(void*) + sizeof(uint) + 2 * sizeof(int);
+    stats.indexBytes = qint64(index.capacity()) * sizeof(void*) + qint64(index.size()) * nodeBytes;
+    stats.bytesPerNode = stats.nodes > 0 ? double(stats.arrayBytes + stats.indexBytes) / stats.nodes : 0.0;
+    return stats;
+}
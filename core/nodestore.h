@@ -0,0 +1,69 @@
+#ifndef NODESTORE_H
+#define NODESTORE_H
+
+#include <QHash>
+#include <QPointF>
+#include <QSizeF>
+#include <QVector>
+#include "figurekind.h"
+
+// Authoritative per-figure state kept as parallel arrays indexed by slot.
+// Scene items only carry their id and read everything else from here, so
+// filters and statistics walk a few contiguous arrays instead of chasing
+// item pointers. Removal swaps the last node into the freed slot; callers
+// hold ids, never slots, across mutations.
+class NodeStore {
+public:
+    enum Flag : quint8 {
+        Hidden = 0x1,
+        Placed = 0x4
+    };
+
+    struct MemoryStats {
+        int nodes;
+        qint64 arrayBytes;
+        qint64 indexBytes;
+        double bytesPerNode;
+    };
+
+    int add(int id, FigureKind kind, const QPointF &pos, const QSizeF &size, int sides = 0);
+    bool remove(int id);
+    void clear();
+
+    int size() const { return nodeIds.size(); }
+    bool contains(int id) const { return index.contains(id); }
+    int slotOf(int id) const { return index.value(id, -1); }
+
+    int idAt(int slot) const { return nodeIds.at(slot); }
+    FigureKind kindAt(int slot) const { return nodeKinds.at(slot); }
+    QPointF positionAt(int slot) const { return QPointF(nodeXs.at(slot), nodeYs.at(slot)); }
+    QSizeF sizeAt(int slot) const { return QSizeF(nodeWidths.at(slot), nodeHeights.at(slot)); }
+    int sidesAt(int slot) const { return nodeSides.at(slot); }
+    bool testFlag(int slot, Flag flag) const { return nodeFlags.at(slot) & flag; }
+
+    void setPosition(int slot, const QPointF &pos);
+    void setFlag(int slot, Flag flag, bool on);
+
+    const QVector<qint32> &ids() const { return nodeIds; }
+    const QVector<FigureKind> &kinds() const { return nodeKinds; }
+    const QVector<quint8> &flags() const { return nodeFlags; }
+    const QVector<float> &xs() const { return nodeXs; }
+    const QVector<float> &ys() const { return nodeYs; }
+    const QVector<float> &widths() const { return nodeWidths; }
+    const QVector<float> &heights() const { return nodeHeights; }
+
+    MemoryStats memory() const;
+
+private:
+    QVector<qint32> nodeIds;
+    QVector<FigureKind> nodeKinds;
+    QVector<float> nodeXs;
+    QVector<float> nodeYs;
+    QVector<float> nodeWidths;
+    QVector<float> nodeHeights;
+    QVector<quint16> nodeSides;
+    QVector<quint8> nodeFlags;
+    QHash<int, int> index;
+};
+
+#endif // NODESTORE_H
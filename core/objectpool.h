@@ -0,0 +1,152 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <QVector>
+#include <cstddef>
+#include <new>
+
+struct PoolStats {
+    quint64 allocations;
+    quint64 frees;
+    quint64 heapFallbacks;
+    int live;
+    int slabs;
+    qint64 reservedBytes;
+};
+
+// Fixed-size slab allocator behind class-level operator new/delete.
+// Objects of exactly Size bytes are carved from slabs of SlabObjects
+// slots and recycled through an intrusive free list; anything else (a
+// derived class, or the pool switched off) goes to the global heap.
+// Empty slabs are returned in one go by trim(). Not thread-safe: the
+// pooled types are scene items, which live on the GUI thread.
+template <std::size_t Size, int SlabObjects = 256>
+class ObjectPool {
+public:
+    ~ObjectPool() {
+        if (live == 0) {
+            trim();
+        }
+    }
+
+    void *allocate(std::size_t size) {
+        ++allocations;
+        if (size != Size || !enabled) {
+            ++heapFallbacks;
+            if (size == Size) {
+                ++liveOnHeap;
+            }
+            return ::operator new(size);
+        }
+
+        if (!freeList) {
+            grow();
+        }
+        Slot *slot = freeList;
+        freeList = slot->next;
+        ++live;
+        return slot;
+    }
+
+    void release(void *ptr, std::size_t size) {
+        if (!ptr) {
+            return;
+        }
+        ++frees;
+        if (size != Size || !enabled) {
+            if (size == Size) {
+                --liveOnHeap;
+            }
+            ::operator delete(ptr);
+            return;
+        }
+
+        Slot *slot = static_cast<Slot *>(ptr);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+    }
+
+    // Releases every slab once no pooled object is alive, e.g. after the
+    // scene has been cleared.
+    bool trim() {
+        if (live != 0) {
+            return false;
+        }
+        for (char *slab : slabs) {
+            ::operator delete(slab);
+        }
+        slabs.clear();
+        freeList = nullptr;
+        return true;
+    }
+
+    // Switching is only allowed while nothing is allocated from the
+    // pool, so every pointer is released the way it was allocated.
+    bool setEnabled(bool on) {
+        if (on == enabled) {
+            return true;
+        }
+        if (live != 0 || liveOnHeap != 0) {
+            return false;
+        }
+        enabled = on;
+        return true;
+    }
+    bool isEnabled() const { return enabled; }
+
+    PoolStats stats() const {
+        PoolStats result = { allocations, frees, heapFallbacks, live, slabs.size(),
+                         qint64(slabs.size() * SlabObjects * sizeof(Slot)) };
+        return result;
+    }
+
+private:
+    union Slot {
+        Slot *next;
+        alignas(std::max_align_t) char storage[Size];
+    };
+
+    void grow() {
+        char *slab = static_cast<char *>(::operator new(SlabObjects * sizeof(Slot)));
+        slabs.append(slab);
+        Slot *slots = reinterpret_cast<Slot *>(slab);
+        for (int i = SlabObjects - 1; i >= 0; --i) {
+            slots[i].next = freeList;
+            freeList = &slots[i];
+        }
+    }
+
+    QVector<char *> slabs;
+    Slot *freeList = nullptr;
+    quint64 allocations = 0;
+    quint64 frees = 0;
+    quint64 heapFallbacks = 0;
+    int live = 0;
+    int liveOnHeap = 0;
+    bool enabled = true;
+};
+
+// Mixin that puts a class's own objects in an ObjectPool of their size:
+//
+//     class Item : public QGraphicsItem, public PooledItem<Item> { ... };
+//
+// Each T gets one pool, shared by every translation unit.
+template <typename T>
+class PooledItem {
+public:
+    static void *operator new(std::size_t size) { return pool().allocate(size); }
+    static void operator delete(void *ptr, std::size_t size) { pool().release(ptr, size); }
+
+    static PoolStats poolStats() { return pool().stats(); }
+    static bool trimPool() { return pool().trim(); }
+    static bool setPoolEnabled(bool enabled) { return pool().setEnabled(enabled); }
+
+private:
+    static ObjectPool<sizeof(T)> &pool() {
+        static ObjectPool<sizeof(T)> instance;
+        return instance;
+    }
+};
+
+#endif // OBJECTPOOL_H
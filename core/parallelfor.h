@@ -0,0 +1,27 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <QVector>
+#include <QtConcurrent>
+
+// Runs body(begin, end) over [0, count) in chunkSize pieces on the global
+// thread pool, or inline when everything fits in one chunk. The body must
+// only write to indices inside its own range.
+template <typename Body>
+void parallelFor(int count, int chunkSize, Body body) {
+    if (count <= chunkSize) {
+        body(0, count);
+        return;
+    }
+
+    QVector<QPair<int, int>> chunks;
+    chunks.reserve(count / chunkSize + 1);
+    for (int begin = 0; begin < count; begin += chunkSize) {
+        chunks.append(qMakePair(begin, qMin(count, begin + chunkSize)));
+    }
+    QtConcurrent::blockingMap(chunks, [&](const QPair<int, int> &chunk) {
+        body(chunk.first, chunk.second);
+    });
+}
+
+#endif // PARALLELFOR_H
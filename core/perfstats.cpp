@@ -0,0 +1,170 @@
+#include "perfstats.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <QtMath>
+
+PerfStats &PerfStats::instance() {
+    static PerfStats stats;
+    return stats;
+}
+
+PerfStats::PerfStats()
+    : categoryCount(0) {
+    for (Histogram &histogram : histograms) {
+        for (auto &bucket : histogram.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        histogram.count.store(0, std::memory_order_relaxed);
+        histogram.total.store(0, std::memory_order_relaxed);
+        histogram.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+int PerfStats::category(const QString &name) {
+    QMutexLocker locker(&registerMutex);
+
+    const int count = categoryCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        if (names[i] == name) {
+            return i;
+        }
+    }
+
+    if (count == MaxCategories) {
+        return -1;
+    }
+
+    names[count] = name;
+    categoryCount.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+int PerfStats::bucketFor(qint64 nanoseconds) {
+    if (nanoseconds < 4) {
+        return qMax<qint64>(0, nanoseconds);
+    }
+
+    const int msb = 63 - qCountLeadingZeroBits(quint64(nanoseconds));
+    const int sub = int((nanoseconds >> (msb - 2)) & 3);
+    return qMin(msb * 4 + sub, int(BucketCount) - 1);
+}
+
+qint64 PerfStats::bucketValue(int bucket) {
+    const int msb = bucket / 4;
+    if (msb < 2) {
+        return bucket;
+    }
+
+    const int sub = bucket % 4;
+    const qint64 lower = qint64(4 + sub) << (msb - 2);
+    const qint64 upper = qint64(5 + sub) << (msb - 2);
+    return (lower + upper) / 2;
+}
+
+void PerfStats::record(int category, qint64 nanoseconds) {
+    if (category < 0 || category >= MaxCategories) {
+        return;
+    }
+
+    Histogram &histogram = histograms[category];
+    histogram.buckets[bucketFor(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.total.fetch_add(quint64(qMax<qint64>(0, nanoseconds)), std::memory_order_relaxed);
+
+    qint64 previous = histogram.max.load(std::memory_order_relaxed);
+    while (nanoseconds > previous
+           && !histogram.max.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+qint64 PerfStats::percentile(const Histogram &histogram, quint64 count, double fraction) const {
+    const quint64 target = qMax<quint64>(1, quint64(qCeil(fraction * count)));
+    quint64 seen = 0;
+    for (int bucket = 0; bucket < BucketCount; ++bucket) {
+        seen += histogram.buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return qMin(bucketValue(bucket), histogram.max.load(std::memory_order_relaxed));
+        }
+    }
+    return histogram.max.load(std::memory_order_relaxed);
+}
+
+PerfStats::Summary PerfStats::summary(int category) const {
+    Summary result = { QString(), 0, 0, 0, 0, 0.0 };
+    if (category < 0 || category >= categoryCount.load(std::memory_order_acquire)) {
+        return result;
+    }
+
+    const Histogram &histogram = histograms[category];
+    result.name = names[category];
+    result.count = histogram.count.load(std::memory_order_relaxed);
+    if (result.count == 0) {
+        return result;
+    }
+
+    result.p50 = percentile(histogram, result.count, 0.50);
+    result.p99 = percentile(histogram, result.count, 0.99);
+    result.max = histogram.max.load(std::memory_order_relaxed);
+    result.mean = double(histogram.total.load(std::memory_order_relaxed)) / result.count;
+    return result;
+}
+
+PerfStats::Summary PerfStats::summary(const QString &name) const {
+    const int count = categoryCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        if (names[i] == name) {
+            return summary(i);
+        }
+    }
+    return summary(-1);
+}
+
+QVector<PerfStats::Summary> PerfStats::summaries() const {
+    QVector<Summary> result;
+    const int count = categoryCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        result.append(summary(i));
+    }
+    return result;
+}
+
+QJsonObject PerfStats::toJson() const {
+    QJsonObject categories;
+    for (const Summary &entry : summaries()) {
+        QJsonObject object;
+        object["count"] = double(entry.count);
+        object["p50_us"] = entry.p50 / 1000.0;
+        object["p99_us"] = entry.p99 / 1000.0;
+        object["max_us"] = entry.max / 1000.0;
+        object["mean_us"] = entry.mean / 1000.0;
+        categories[entry.name] = object;
+    }
+
+    QJsonObject root;
+    root["categories"] = categories;
+    return root;
+}
+
+bool PerfStats::writeJson(const QString &fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(toJson()).toJson());
+    return true;
+}
+
+void PerfStats::reset() {
+    const int count = categoryCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        Histogram &histogram = histograms[i];
+        for (auto &bucket : histogram.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        histogram.count.store(0, std::memory_order_relaxed);
+        histogram.total.store(0, std::memory_order_relaxed);
+        histogram.max.store(0, std::memory_order_relaxed);
+    }
+}
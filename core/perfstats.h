@@ -0,0 +1,73 @@
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// Process-wide latency histograms. Categories are registered once by name
+// (under a mutex) and recording into them is lock-free, so timers can run
+// on the GUI thread and on workers alike. Buckets are log-scaled with four
+// sub-buckets per power of two, i.e. percentiles are accurate to ~19%.
+class PerfStats {
+public:
+    enum {
+        MaxCategories = 128,
+        BucketCount = 176
+    };
+
+    struct Summary {
+        QString name;
+        quint64 count;
+        qint64 p50;
+        qint64 p99;
+        qint64 max;
+        double mean;
+    };
+
+    static PerfStats &instance();
+
+    int category(const QString &name);
+    void record(int category, qint64 nanoseconds);
+
+    Summary summary(int category) const;
+    Summary summary(const QString &name) const;
+    QVector<Summary> summaries() const;
+
+    QJsonObject toJson() const;
+    bool writeJson(const QString &fileName) const;
+    void reset();
+
+private:
+    struct Histogram {
+        std::atomic<quint64> buckets[BucketCount];
+        std::atomic<quint64> count;
+        std::atomic<quint64> total;
+        std::atomic<qint64> max;
+    };
+
+    PerfStats();
+    static int bucketFor(qint64 nanoseconds);
+    static qint64 bucketValue(int bucket);
+    qint64 percentile(const Histogram &histogram, quint64 count, double fraction) const;
+
+    Histogram histograms[MaxCategories];
+    QString names[MaxCategories];
+    std::atomic<int> categoryCount;
+    mutable QMutex registerMutex;
+};
+
+class PerfTimer {
+public:
+    explicit PerfTimer(int category) : category(category) { timer.start(); }
+    ~PerfTimer() { PerfStats::instance().record(category, timer.nsecsElapsed()); }
+
+private:
+    int category;
+    QElapsedTimer timer;
+};
+
+#endif // PERFSTATS_H
@@ -0,0 +1,27 @@
+#ifndef PROCESSMEMORY_H
+#define PROCESSMEMORY_H
+
+#include <QtGlobal>
+
+#ifdef Q_OS_LINUX
+#include <QFile>
+#include <QList>
+#include <unistd.h>
+#endif
+
+// Resident set size of the current process in bytes, or -1 where the
+// platform does not expose it cheaply.
+inline qint64 residentSetBytes() {
+#ifdef Q_OS_LINUX
+    QFile file(QStringLiteral("/proc/self/statm"));
+    if (file.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = file.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
+#endif // PROCESSMEMORY_H
@@ -0,0 +1,156 @@
+#include "scriptrunner.h"
+#include "perfstats.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegularExpression>
+
+void ScriptRunner::addCommand(const QString &name, int minArgs, const QString &usage, Handler handler) {
+    Command command = { handler, minArgs, usage,
+                        PerfStats::instance().category("batch:" + name), 0, 0, 0 };
+    if (!commands.contains(name)) {
+        order << name;
+    }
+    commands.insert(name, command);
+}
+
+bool ScriptRunner::run(const QString &fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QElapsedTimer wall;
+    wall.start();
+
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        ++lineNumber;
+        if (!runLine(in.readLine())) {
+            error = QString("%1:%2: %3").arg(fileName).arg(lineNumber).arg(error);
+            wallNs += wall.nsecsElapsed();
+            return false;
+        }
+    }
+
+    wallNs += wall.nsecsElapsed();
+    return failures == 0;
+}
+
+bool ScriptRunner::runLine(const QString &line) {
+    const QString text = line.section('#', 0, 0).trimmed();
+    if (text.isEmpty()) {
+        return true;
+    }
+
+    QStringList args = text.split(QRegularExpression("\\s+"));
+    const QString name = args.takeFirst();
+
+    if (name == "repeat") {
+        bool ok = false;
+        const int times = args.value(0).toInt(&ok);
+        if (!ok || times < 0 || args.size() < 2) {
+            error = "usage: repeat N <command> [args]";
+            return false;
+        }
+        const QString command = args.at(1);
+        const QStringList pattern = args.mid(2);
+        for (int i = 1; i <= times; ++i) {
+            if (!execute(command, expand(pattern, i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (name == "dump-perf") {
+        if (args.isEmpty() || !PerfStats::instance().writeJson(args.first())) {
+            error = "dump-perf: cannot write " + args.value(0);
+            return false;
+        }
+        return true;
+    }
+
+    return execute(name, args);
+}
+
+bool ScriptRunner::execute(const QString &name, const QStringList &args) {
+    auto it = commands.find(name);
+    if (it == commands.end()) {
+        error = "unknown command: " + name;
+        return false;
+    }
+
+    Command &command = it.value();
+    if (args.size() < command.minArgs) {
+        error = "usage: " + name + " " + command.usage;
+        return false;
+    }
+
+    // A failing operation is counted and reported but does not stop the
+    // script; only malformed lines do.
+    QString message;
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = command.handler(args, &message);
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    PerfStats::instance().record(command.category, elapsed);
+    ++command.calls;
+    command.totalNs += elapsed;
+    if (!ok) {
+        ++command.failures;
+        ++failures;
+        QTextStream(stderr) << name << " " << args.join(' ') << ": " << message << "\n";
+    }
+    return true;
+}
+
+QStringList ScriptRunner::expand(const QStringList &args, int iteration) {
+    static const QRegularExpression placeholder("\\{n(?:([+-])(\\d+))?\\}");
+
+    QStringList result;
+    result.reserve(args.size());
+    for (const QString &arg : args) {
+        QString expanded;
+        int last = 0;
+        QRegularExpressionMatchIterator matches = placeholder.globalMatch(arg);
+        while (matches.hasNext()) {
+            QRegularExpressionMatch match = matches.next();
+            int value = iteration;
+            if (match.capturedLength(1) > 0) {
+                const int offset = match.captured(2).toInt();
+                value += match.captured(1) == "+" ? offset : -offset;
+            }
+            expanded += arg.midRef(last, match.capturedStart() - last);
+            expanded += QString::number(value);
+            last = match.capturedEnd();
+        }
+        expanded += arg.midRef(last);
+        result << expanded;
+    }
+    return result;
+}
+
+void ScriptRunner::printReport(QTextStream &out) const {
+    out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+           .arg("command", -14).arg("calls", 8).arg("failed", 7).arg("total ms", 10)
+           .arg("ops/s", 10).arg("p50 us", 9).arg("p99 us", 9);
+
+    for (const QString &name : order) {
+        const Command &command = commands.value(name);
+        if (command.calls == 0) {
+            continue;
+        }
+        PerfStats::Summary summary = PerfStats::instance().summary(command.category);
+        const double seconds = command.totalNs / 1e9;
+        out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+               .arg(name, -14).arg(command.calls, 8).arg(command.failures, 7)
+               .arg(command.totalNs / 1e6, 10, 'f', 2)
+               .arg(seconds > 0 ? command.calls / seconds : 0.0, 10, 'f', 0)
+               .arg(summary.p50 / 1e3, 9, 'f', 1).arg(summary.p99 / 1e3, 9, 'f', 1);
+    }
+
+    out << QString("wall %1 ms, %2 failed operations\n").arg(wallNs / 1e6, 0, 'f', 2).arg(failures);
+}
@@ -0,0 +1,53 @@
+#ifndef SCRIPTRUNNER_H
+#define SCRIPTRUNNER_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <functional>
+
+// Runs a line-oriented operation script against handlers registered by
+// the application. One command per line, '#' starts a comment. Built-ins:
+//
+//   repeat N <command> [args]   run a command N times; {n}, {n+K} and
+//                               {n-K} in its arguments expand to the
+//                               1-based iteration number
+//   dump-perf FILE              write PerfStats as JSON
+//
+// Every command is timed into PerfStats ("batch:<name>") and into its own
+// aggregate for the throughput report.
+class ScriptRunner {
+public:
+    using Handler = std::function<bool(const QStringList &args, QString *error)>;
+
+    void addCommand(const QString &name, int minArgs, const QString &usage, Handler handler);
+
+    bool run(const QString &fileName);
+    bool runLine(const QString &line);
+
+    void printReport(QTextStream &out) const;
+    QString lastError() const { return error; }
+
+private:
+    struct Command {
+        Handler handler;
+        int minArgs;
+        QString usage;
+        int category;
+        quint64 calls;
+        quint64 failures;
+        qint64 totalNs;
+    };
+
+    bool execute(const QString &name, const QStringList &args);
+    static QStringList expand(const QStringList &args, int iteration);
+
+    QHash<QString, Command> commands;
+    QStringList order;
+    qint64 wallNs = 0;
+    quint64 failures = 0;
+    QString error;
+};
+
+#endif // SCRIPTRUNNER_H
@@ -0,0 +1,201 @@
+#include "spatialgrid.h"
+#include <QtMath>
+
+namespace {
+
+// Even-odd containment with the polygon edges bucketed into horizontal
+// bands, so each point is only tested against the edges crossing its band.
+class PolygonTester {
+public:
+    explicit PolygonTester(const QPolygonF &polygon)
+        : polygon(polygon), bounds(polygon.boundingRect()) {
+        const int n = polygon.size();
+        bandCount = qBound(1, n / 4, 1024);
+        bandHeight = bounds.height() > 0 ? bounds.height() / bandCount : 1;
+        bands.resize(bandCount);
+
+        for (int i = 0, j = n - 1; i < n; j = i++) {
+            const qreal top = qMin(polygon[i].y(), polygon[j].y());
+            const qreal bottom = qMax(polygon[i].y(), polygon[j].y());
+            const int first = band(top);
+            const int last = band(bottom);
+            for (int b = first; b <= last; ++b) {
+                bands[b].append(i);
+            }
+        }
+    }
+
+    bool contains(const QPointF &point) const {
+        if (!bounds.contains(point)) {
+            return false;
+        }
+
+        const int n = polygon.size();
+        bool inside = false;
+        for (int i : bands.at(band(point.y()))) {
+            const QPointF &a = polygon[i];
+            const QPointF &b = polygon[i == 0 ? n - 1 : i - 1];
+            if ((a.y() > point.y()) != (b.y() > point.y())
+                    && point.x() < (b.x() - a.x()) * (point.y() - a.y()) / (b.y() - a.y()) + a.x()) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+private:
+    int band(qreal y) const {
+        return qBound(0, int((y - bounds.top()) / bandHeight), bandCount - 1);
+    }
+
+    const QPolygonF &polygon;
+    QRectF bounds;
+    int bandCount;
+    qreal bandHeight;
+    QVector<QVector<int>> bands;
+};
+
+}
+
+SpatialGrid::SpatialGrid(qreal cellSize)
+    : cellSize(cellSize) {}
+
+quint64 SpatialGrid::cellKey(int column, int row) const {
+    return (quint64(quint32(column)) << 32) | quint32(row);
+}
+
+int SpatialGrid::column(qreal x) const {
+    return qFloor(x / cellSize);
+}
+
+int SpatialGrid::row(qreal y) const {
+    return qFloor(y / cellSize);
+}
+
+void SpatialGrid::insert(int id, const QPointF &pos) {
+    if (entries.contains(id)) {
+        move(id, pos);
+        return;
+    }
+
+    const quint64 key = cellKey(column(pos.x()), row(pos.y()));
+    QVector<Point> &cell = cells[key];
+    const Entry entry = { key, cell.size() };
+    const Point point = { id, pos };
+    entries.insert(id, entry);
+    cell.append(point);
+}
+
+void SpatialGrid::move(int id, const QPointF &pos) {
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        insert(id, pos);
+        return;
+    }
+
+    const quint64 key = cellKey(column(pos.x()), row(pos.y()));
+    if (key == it->cell) {
+        cells[key][it->slot].pos = pos;
+        return;
+    }
+
+    remove(id);
+    insert(id, pos);
+}
+
+void SpatialGrid::remove(int id) {
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        return;
+    }
+
+    auto cellIt = cells.find(it->cell);
+    QVector<Point> &cell = cellIt.value();
+    const int slot = it->slot;
+
+    if (slot != cell.size() - 1) {
+        cell[slot] = cell.last();
+        entries[cell[slot].id].slot = slot;
+    }
+    cell.removeLast();
+    if (cell.isEmpty()) {
+        cells.erase(cellIt);
+    }
+
+    entries.remove(id);
+}
+
+void SpatialGrid::clear() {
+    cells.clear();
+    entries.clear();
+}
+
+template <typename Visitor>
+void SpatialGrid::visitCells(const QRectF &rect, Visitor visit) const {
+    const int column0 = column(rect.left());
+    const int column1 = column(rect.right());
+    const int row0 = row(rect.top());
+    const int row1 = row(rect.bottom());
+    const qint64 span = qint64(column1 - column0 + 1) * (row1 - row0 + 1);
+
+    // A query covering more cells than are occupied walks the occupied ones.
+    if (span > cells.size()) {
+        for (auto it = cells.constBegin(); it != cells.constEnd(); ++it) {
+            const int c = int(qint32(it.key() >> 32));
+            const int r = int(qint32(it.key() & 0xffffffffu));
+            if (c >= column0 && c <= column1 && r >= row0 && r <= row1) {
+                visit(c, r, it.value());
+            }
+        }
+        return;
+    }
+
+    for (int c = column0; c <= column1; ++c) {
+        for (int r = row0; r <= row1; ++r) {
+            auto it = cells.constFind(cellKey(c, r));
+            if (it != cells.constEnd()) {
+                visit(c, r, it.value());
+            }
+        }
+    }
+}
+
+QVector<int> SpatialGrid::query(const QRectF &rect) const {
+    const QRectF area = rect.normalized();
+    QVector<int> result;
+
+    visitCells(area, [&](int c, int r, const QVector<Point> &cell) {
+        const QRectF cellRect(c * cellSize, r * cellSize, cellSize, cellSize);
+        if (area.contains(cellRect)) {
+            for (const Point &point : cell) {
+                result.append(point.id);
+            }
+            return;
+        }
+        for (const Point &point : cell) {
+            if (area.contains(point.pos)) {
+                result.append(point.id);
+            }
+        }
+    });
+
+    return result;
+}
+
+QVector<int> SpatialGrid::query(const QPolygonF &polygon) const {
+    QVector<int> result;
+    if (polygon.size() < 3) {
+        return result;
+    }
+
+    const PolygonTester tester(polygon);
+    visitCells(polygon.boundingRect(), [&](int, int, const QVector<Point> &cell) {
+        for (const Point &point : cell) {
+            if (tester.contains(point.pos)) {
+                result.append(point.id);
+            }
+        }
+    });
+
+    return result;
+}
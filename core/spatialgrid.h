@@ -0,0 +1,51 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QHash>
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+#include <QVector>
+
+// Uniform grid over figure centres. Insert, move and remove are O(1);
+// area queries only visit the cells overlapping the query's bounding box
+// and take whole cells without per-point tests when they lie inside it.
+class SpatialGrid {
+public:
+    explicit SpatialGrid(qreal cellSize = 128);
+
+    void insert(int id, const QPointF &pos);
+    void move(int id, const QPointF &pos);
+    void remove(int id);
+    void clear();
+
+    int size() const { return entries.size(); }
+    bool contains(int id) const { return entries.contains(id); }
+
+    QVector<int> query(const QRectF &rect) const;
+    QVector<int> query(const QPolygonF &polygon) const;
+
+private:
+    struct Point {
+        int id;
+        QPointF pos;
+    };
+
+    struct Entry {
+        quint64 cell;
+        int slot;
+    };
+
+    quint64 cellKey(int column, int row) const;
+    int column(qreal x) const;
+    int row(qreal y) const;
+
+    template <typename Visitor>
+    void visitCells(const QRectF &rect, Visitor visit) const;
+
+    qreal cellSize;
+    QHash<quint64, QVector<Point>> cells;
+    QHash<int, Entry> entries;
+};
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,159 @@
+#include "sqlexecutor.h"
+#include "perfstats.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QTextStream>
+#include <algorithm>
+
+SqlExecutor &SqlExecutor::instance() {
+    static SqlExecutor executor;
+    return executor;
+}
+
+bool SqlExecutor::exec(QSqlQuery &query, const char *site) {
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.exec();
+    instance().record(query, site, timer.nsecsElapsed(), ok);
+    return ok;
+}
+
+bool SqlExecutor::exec(QSqlQuery &query, const QString &sql, const char *site) {
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.prepare(sql) && query.exec();
+    instance().record(query, site, timer.nsecsElapsed(), ok);
+    return ok;
+}
+
+bool SqlExecutor::execBatch(QSqlQuery &query, const char *site) {
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.execBatch();
+    instance().record(query, site, timer.nsecsElapsed(), ok);
+    return ok;
+}
+
+void SqlExecutor::record(QSqlQuery &query, const char *site, qint64 nanoseconds, bool ok) {
+    qint64 rows = -1;
+    if (ok) {
+        if (!query.isSelect()) {
+            rows = query.numRowsAffected();
+        } else if (query.driver() && query.driver()->hasFeature(QSqlDriver::QuerySize)) {
+            rows = query.size();
+        }
+    }
+
+    const QString sql = query.lastQuery();
+    const QString key = QString::fromLatin1(site) + QLatin1Char('\n') + sql;
+    int category;
+    bool slow;
+
+    {
+        QMutexLocker locker(&mutex);
+        auto it = stats.find(key);
+        if (it == stats.end()) {
+            Aggregate created = { QString::fromLatin1(site), sql, 0, 0, 0, 0, 0, 0,
+                                  PerfStats::instance().category(QString("sql:") + site) };
+            it = stats.insert(key, created);
+        }
+
+        Aggregate &aggregate = it.value();
+        ++aggregate.calls;
+        if (!ok) {
+            ++aggregate.failures;
+        }
+        aggregate.totalNs += nanoseconds;
+        aggregate.maxNs = qMax(aggregate.maxNs, nanoseconds);
+        aggregate.rows += qMax<qint64>(0, rows);
+        aggregate.binds = query.boundValues().size();
+        category = aggregate.category;
+        slow = nanoseconds >= thresholdNs;
+    }
+
+    PerfStats::instance().record(category, nanoseconds);
+
+    if (!ok) {
+        qWarning() << "SQL failed at" << site << ":" << query.lastError().text();
+    }
+    if (slow) {
+        logSlow(query, site, nanoseconds, rows);
+    }
+}
+
+void SqlExecutor::logSlow(QSqlQuery &query, const char *site, qint64 nanoseconds, qint64 rows) {
+    const QString sql = query.lastQuery();
+    const int binds = query.boundValues().size();
+
+    // The plan is asked on the query's own connection: the statement may
+    // have run on a worker thread's connection, and a connection may only
+    // be used from the thread that opened it.
+    QStringList plan;
+    QSqlDriver *driver = query.driver();
+    if (driver && driver->dbmsType() == QSqlDriver::SQLite) {
+        QSqlQuery explain(driver->createResult());
+        if (explain.prepare("EXPLAIN QUERY PLAN " + sql)) {
+            for (int i = 0; i < binds; ++i) {
+                explain.addBindValue(query.boundValue(i));
+            }
+            if (explain.exec()) {
+                while (explain.next()) {
+                    plan << explain.value(3).toString();
+                }
+            }
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    QFile file(slowLogFile);
+    if (!file.open(QIODevice::Append | QIODevice::Text)) {
+        return;
+    }
+
+    QTextStream out(&file);
+    out << QDateTime::currentDateTime().toString(Qt::ISODateWithMs)
+        << " [" << site << "] " << QString::number(nanoseconds / 1e6, 'f', 2) << " ms"
+        << " rows=" << rows << " binds=" << binds << "\n"
+        << "  SQL: " << sql.simplified() << "\n";
+    for (const QString &step : plan) {
+        out << "  PLAN: " << step << "\n";
+    }
+}
+
+void SqlExecutor::setSlowThreshold(qint64 milliseconds) {
+    QMutexLocker locker(&mutex);
+    thresholdNs = milliseconds * 1000 * 1000;
+}
+
+qint64 SqlExecutor::slowThreshold() const {
+    QMutexLocker locker(&mutex);
+    return thresholdNs / (1000 * 1000);
+}
+
+void SqlExecutor::setSlowLogFile(const QString &fileName) {
+    QMutexLocker locker(&mutex);
+    slowLogFile = fileName;
+}
+
+QVector<SqlExecutor::Aggregate> SqlExecutor::aggregates() const {
+    QMutexLocker locker(&mutex);
+    QVector<Aggregate> result;
+    result.reserve(stats.size());
+    for (const Aggregate &aggregate : stats) {
+        result.append(aggregate);
+    }
+    std::sort(result.begin(), result.end(), [](const Aggregate &a, const Aggregate &b) {
+        return a.totalNs > b.totalNs;
+    });
+    return result;
+}
+
+void SqlExecutor::reset() {
+    QMutexLocker locker(&mutex);
+    stats.clear();
+}
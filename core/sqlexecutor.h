@@ -0,0 +1,52 @@
+#ifndef SQLEXECUTOR_H
+#define SQLEXECUTOR_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSqlQuery>
+#include <QString>
+#include <QVector>
+
+// Every statement in the figures store goes through here. Each call is
+// timed and folded into a per (call site, SQL text) aggregate; statements
+// slower than the threshold are appended to the slow-query log together
+// with their EXPLAIN QUERY PLAN output.
+class SqlExecutor {
+public:
+    struct Aggregate {
+        QString site;
+        QString sql;
+        quint64 calls;
+        quint64 failures;
+        qint64 totalNs;
+        qint64 maxNs;
+        qint64 rows;
+        int binds;
+        int category;
+    };
+
+    static SqlExecutor &instance();
+
+    static bool exec(QSqlQuery &query, const char *site);
+    static bool exec(QSqlQuery &query, const QString &sql, const char *site);
+    static bool execBatch(QSqlQuery &query, const char *site);
+
+    void setSlowThreshold(qint64 milliseconds);
+    qint64 slowThreshold() const;
+    void setSlowLogFile(const QString &fileName);
+
+    QVector<Aggregate> aggregates() const;
+    void reset();
+
+private:
+    SqlExecutor() = default;
+    void record(QSqlQuery &query, const char *site, qint64 nanoseconds, bool ok);
+    void logSlow(QSqlQuery &query, const char *site, qint64 nanoseconds, qint64 rows);
+
+    mutable QMutex mutex;
+    QHash<QString, Aggregate> stats;
+    qint64 thresholdNs = 20 * 1000 * 1000;
+    QString slowLogFile = "slow_queries.log";
+};
+
+#endif // SQLEXECUTOR_H
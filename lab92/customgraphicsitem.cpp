@@ -1,12 +1,16 @@
 #include "customgraphicsitem.h"
+#include "scene.h"
+#include "geometrycache.h"
 #include <QGraphicsLineItem>
 #include <QGraphicsItem>
 #include <QList>
 #include <QPair>
 #include <QGraphicsScene>
 #include <QGraphicsSceneMouseEvent>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
 
-void CustomGraphicsItem::addConnection(CustomGraphicsItem *other, QGraphicsLineItem *line) {
+void CustomGraphicsItem::addConnection(CustomGraphicsItem *other, ConnectionLine *line) {
     connections.append({other, line});
 }
 
@@ -25,14 +29,9 @@ void CustomGraphicsItem::removeConnection(CustomGraphicsItem *other) {
 }
 
 QVariant CustomGraphicsItem::itemChange(GraphicsItemChange change, const QVariant &value) {
-    if (change == ItemPositionChange) {
-        for (auto &conn : connections) {
-            CustomGraphicsItem *other = conn.first;
-            QGraphicsLineItem *line = conn.second;
-
-            QPointF point1 = this->scenePos();
-            QPointF point2 = other->scenePos();
-            line->setLine(QLineF(point1, point2));
+    if (change == ItemPositionHasChanged) {
+        if (auto *owner = qobject_cast<Scene *>(scene())) {
+            owner->itemMoved(this);
         }
     }
     return QGraphicsItemGroup::itemChange(change, value);
@@ -40,21 +39,26 @@ QVariant CustomGraphicsItem::itemChange(GraphicsItemChange change, const QVarian
 
 void CustomGraphicsItem::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
 
+    // The move reaches the scene through itemChange(), which marks the
+    // connections stale.
     setPos(mapToScene(event->pos()));
 
-    updateConnections();
-
     QGraphicsItem::mouseMoveEvent(event);
 }
 
-void CustomGraphicsItem::updateConnections() {
-    for (auto &conn : connections) {
-        CustomGraphicsItem *otherItem = conn.first;
-        QGraphicsLineItem *line = conn.second;
+PolygonShape::PolygonShape(int sides, qreal radius, QGraphicsItem *parent)
+    : QGraphicsPolygonItem(GeometryCache::instance().regularPolygon(sides, radius), parent),
+      sides(sides), radius(radius) {}
+
+QPainterPath PolygonShape::shape() const {
+    return GeometryCache::instance().polygonPath(sides, radius, 1);
+}
 
-        QPointF point1 = mapToScene(boundingRect().center());
-        QPointF point2 = otherItem->mapToScene(otherItem->boundingRect().center());
+void PolygonShape::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    Q_UNUSED(widget)
 
-        line->setLine(QLineF(point1, point2));
-    }
+    const qreal levelOfDetail = option->levelOfDetailFromTransform(painter->worldTransform());
+    painter->setPen(pen());
+    painter->setBrush(brush());
+    painter->drawPath(GeometryCache::instance().polygonPath(sides, radius, levelOfDetail));
 }
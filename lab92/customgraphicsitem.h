@@ -2,26 +2,67 @@
 #define CUSTOMGRAPHICSITEM_H
 
 #include <QGraphicsLineItem>
+#include <QGraphicsPolygonItem>
 #include <QGraphicsItem>
 #include <QList>
 #include <QPair>
+#include "objectpool.h"
 
-class CustomGraphicsItem : public QGraphicsItemGroup {
+class ConnectionLine;
+
+// Groups are carved from a slab pool; the child shape items Qt creates
+// and deletes for them stay on the heap.
+class CustomGraphicsItem : public QGraphicsItemGroup, public PooledItem<CustomGraphicsItem> {
 public:
     explicit CustomGraphicsItem(QGraphicsItem *parent = nullptr) : QGraphicsItemGroup(parent) {}
 
-    QList<QPair<CustomGraphicsItem *, QGraphicsLineItem *>> connections;
+    int nodeId() const { return id; }
+    void setNodeId(int nodeId) { id = nodeId; }
 
-    void addConnection(CustomGraphicsItem *other, QGraphicsLineItem *line);
+    QList<QPair<CustomGraphicsItem *, ConnectionLine *>> connections;
 
-    void removeConnection(CustomGraphicsItem *other);
+    void addConnection(CustomGraphicsItem *other, ConnectionLine *line);
 
-    void updateConnections();
+    void removeConnection(CustomGraphicsItem *other);
 
     void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
 
 protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+
+private:
+    int id = -1;
+};
+
+class ConnectionLine : public QGraphicsLineItem, public PooledItem<ConnectionLine> {
+public:
+    explicit ConnectionLine(const QLineF &line, QGraphicsItem *parent = nullptr)
+        : QGraphicsLineItem(line, parent) {}
+
+private:
+    friend class Scene;
+    template <typename> friend class StaleLines;
+
+    // Set for lines between two shapes, so the scene can recompute a
+    // stale line without looking up its owners.
+    int fromId = -1;
+    int toId = -1;
+    int staleIndex = -1;
+};
+
+// A regular polygon drawn from the shared geometry cache: the outline is
+// simplified to what the current zoom can show, and hit testing uses a
+// cached path instead of one rebuilt from the polygon on every query.
+class PolygonShape : public QGraphicsPolygonItem {
+public:
+    PolygonShape(int sides, qreal radius, QGraphicsItem *parent = nullptr);
+
+    QPainterPath shape() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    int sides;
+    qreal radius;
 };
 
 #endif
@@ -40,6 +40,9 @@ HEADERS += \
 FORMS += \
         mainwindow.ui
 
+include(../core/core.pri)
+include(../common/common.pri)
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -1,15 +1,33 @@
 #include "MainWindow.h"
 #include "Scene.h"
 #include "ShapeModel.h"
+#include "sceneexporter.h"
+#include "perfstats.h"
+#include "scriptrunner.h"
+#include "customgraphicsitem.h"
+#include "minimapwidget.h"
+#include "tracereplayer.h"
+#include "scenecommands.h"
 #include <QSplitter>
 #include <QVBoxLayout>
 #include <QFormLayout>
 #include <QLabel>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QAction>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QDockWidget>
+#include <QDebug>
 
-MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), scene(new Scene(this)), model(new ShapeModel(this)) {
+MainWindow::MainWindow(QWidget *parent, bool batchMode)
+    : QMainWindow(parent), scene(new Scene(this)), model(new ShapeModel(this)), batchMode(batchMode) {
 
-    view = new QGraphicsView(scene, this);
+    view = new PerfView(scene, this);
+    view->setCountsProvider([this]() {
+        return qMakePair(scene->shapeCount(), scene->connectionCount());
+    });
+    recorder = new TraceRecorder(view, [this]() { return scene->snapshot(); }, this);
     tableView = new QTableView(this);
     tableView->setModel(model);
 
@@ -19,6 +37,9 @@ MainWindow::MainWindow(QWidget *parent)
     addConnectionButton = new QPushButton("Создать связь", this);
     deleteButton = new QPushButton("Удалить выбранное", this);
     filterButton = new QPushButton("Фильтровать", this);
+    exportImageButton = new QPushButton("Экспорт в PNG", this);
+    exportTilesButton = new QPushButton("Экспорт тайлами", this);
+    layoutButton = new QPushButton("Авторасстановка", this);
 
     filterValueLineEdit = new QLineEdit(this);
     filterTypeComboBox = new QComboBox(this);
@@ -54,6 +75,9 @@ MainWindow::MainWindow(QWidget *parent)
     layout->addWidget(addPolygonButton);
     layout->addWidget(addConnectionButton);
     layout->addWidget(deleteButton);
+    layout->addWidget(exportImageButton);
+    layout->addWidget(exportTilesButton);
+    layout->addWidget(layoutButton);
 
     QWidget *widget = new QWidget;
     widget->setLayout(layout);
@@ -62,27 +86,143 @@ MainWindow::MainWindow(QWidget *parent)
     connect(addRectButton, &QPushButton::clicked, this, &MainWindow::addRectangle);
     connect(addEllipseButton, &QPushButton::clicked, this, &MainWindow::addEllipse);
     connect(addPolygonButton, &QPushButton::clicked, this, &MainWindow::addPolygon);
-    connect(addConnectionButton, &QPushButton::clicked, scene, &Scene::startConnectionMode);
+    connect(addConnectionButton, &QPushButton::clicked, this, &MainWindow::startConnectionMode);
     connect(deleteButton, &QPushButton::clicked, this, &MainWindow::deleteSelected);
     connect(filterButton, &QPushButton::clicked, this, &MainWindow::filterShapes);
+    connect(exportImageButton, &QPushButton::clicked, this, &MainWindow::exportImage);
+    connect(exportTilesButton, &QPushButton::clicked, this, &MainWindow::exportTiles);
+    connect(layoutButton, &QPushButton::clicked, this, &MainWindow::toggleLayout);
+    connect(scene, &Scene::layoutFinished, this, [this]() {
+        layoutButton->setText("Авторасстановка");
+    });
+
+    QAction *layoutNewAction = new QAction("Layout New", this);
+    layoutNewAction->setShortcut(QKeySequence("Ctrl+Shift+L"));
+    addAction(layoutNewAction);
+    connect(layoutNewAction, &QAction::triggered, this, [this]() {
+        if (scene->startLayout(true)) {
+            layoutButton->setText("Остановить расстановку");
+            recorder->recordAction("layout new");
+        }
+    });
+
+    QDockWidget *minimapDock = new QDockWidget("Обзор", this);
+    minimapDock->setObjectName("minimapDock");
+    minimapDock->setWidget(new MinimapWidget(view, minimapDock));
+    addDockWidget(Qt::RightDockWidgetArea, minimapDock);
+    QAction *minimapAction = minimapDock->toggleViewAction();
+    minimapAction->setShortcut(QKeySequence("Ctrl+M"));
+    addAction(minimapAction);
+
+    QAction *hudAction = new QAction("HUD", this);
+    hudAction->setCheckable(true);
+    hudAction->setShortcut(Qt::Key_F3);
+    addAction(hudAction);
+    connect(hudAction, &QAction::toggled, view, &PerfView::setHudVisible);
+
+    QAction *dumpAction = new QAction("Dump Perf JSON", this);
+    dumpAction->setShortcut(QKeySequence("Ctrl+Shift+J"));
+    addAction(dumpAction);
+    connect(dumpAction, &QAction::triggered, this, [this]() {
+        if (!PerfStats::instance().writeJson("perf.json")) {
+            QMessageBox::warning(this, "Ошибка", "Не удалось записать perf.json");
+        }
+    });
+
+    QAction *traceAction = new QAction("Record Trace", this);
+    traceAction->setCheckable(true);
+    traceAction->setShortcut(QKeySequence("Ctrl+Shift+R"));
+    addAction(traceAction);
+    connect(traceAction, &QAction::toggled, recorder, &TraceRecorder::setRecording);
+
+    if (!batchMode) {
+        startAutosave("shapes.autosave");
+    }
+}
+
+MainWindow::~MainWindow() {
+    scene->setJournal(nullptr);
+    delete journal;
+}
+
+bool MainWindow::startAutosave(const QString &directory) {
+    if (journal) {
+        return false;
+    }
+
+    ChangeJournal::State state;
+    QString error;
+    QElapsedTimer timer;
+    timer.start();
+    if (!ChangeJournal::load(directory, &state, &error)) {
+        // Journaling on top of unreadable files would overwrite them at
+        // the next compaction, so autosave stays off.
+        if (batchMode) {
+            qWarning().noquote() << "Не удалось восстановить автосохранение:" << error;
+        } else {
+            QMessageBox::warning(this, "Ошибка", "Не удалось восстановить автосохранение: " + error);
+        }
+        return false;
+    }
+    scene->restore(state);
+
+    journal = new ChangeJournal(directory);
+    if (!journal->start(state)) {
+        qWarning().noquote() << "Autosave disabled:" << journal->lastError();
+        delete journal;
+        journal = nullptr;
+        return false;
+    }
+    scene->setJournal(journal);
+
+    if (batchMode && !state.nodes.isEmpty()) {
+        QTextStream(stdout) << "recovered " << state.nodes.size() << " shapes and " << state.links.size()
+                            << " links in " << timer.elapsed() << " ms\n";
+    }
+    return true;
+}
+
+void MainWindow::toggleLayout() {
+    if (scene->isLayoutRunning()) {
+        scene->cancelLayout();
+    } else if (scene->startLayout(false)) {
+        layoutButton->setText("Остановить расстановку");
+        recorder->recordAction("layout");
+    }
+}
+
+// New shapes land at a random position, so the trace pins the id and
+// position each one got; replayed clicks then hit the same shapes.
+void MainWindow::recordCreated(const QString &command, int id) {
+    const NodeStore &nodes = scene->nodeStore();
+    const int slot = nodes.slotOf(id);
+    if (slot < 0) return;
+
+    const QPointF pos = nodes.positionAt(slot);
+    recorder->recordAction(QString("%1 %2 %3 %4").arg(command).arg(id).arg(pos.x()).arg(pos.y()));
 }
 
 void MainWindow::addRectangle() {
-    scene->addRectangle();
+    recordCreated("rectangle", scene->addRectangle());
 }
 
 void MainWindow::addEllipse() {
-    scene->addEllipse();
+    recordCreated("ellipse", scene->addEllipse());
 }
 
 void MainWindow::addPolygon() {
     bool ok;
     int sides = polygonSidesLineEdit->text().toInt(&ok);
     if (ok && sides >= 3) {
-        scene->addPolygon(sides);
+        recordCreated(QString("polygon %1").arg(sides), scene->addPolygon(sides));
     }
 }
 
+void MainWindow::startConnectionMode() {
+    scene->startConnectionMode();
+    recorder->recordAction("connect-mode");
+}
+
 void MainWindow::addConnection() {
     auto selectedItems = scene->selectedItems();
 
@@ -104,10 +244,214 @@ void MainWindow::addConnection() {
 
 void MainWindow::deleteSelected() {
     scene->deleteSelected();
+    recorder->recordAction("delete-selected");
 }
 
 void MainWindow::filterShapes() {
     QString filterType = filterTypeComboBox->currentData().toString();
     QString filterValue = filterValueLineEdit->text();
     scene->filterShapes(filterType, filterValue);
+    if (TraceRecorder::isScriptSafe(filterValue)) {
+        recorder->recordAction(QString("filter %1 %2").arg(filterType, filterValue));
+    }
+}
+
+void MainWindow::exportImage() {
+    QString fileName = QFileDialog::getSaveFileName(this, "Экспорт в PNG", "scene.png", "PNG (*.png)");
+    if (fileName.isEmpty()) return;
+
+    SceneExporter exporter(scene);
+    if (!exporter.exportImage(fileName)) {
+        QMessageBox::warning(this, "Ошибка", exporter.lastError());
+    }
+}
+
+void MainWindow::exportTiles() {
+    QString dirPath = QFileDialog::getExistingDirectory(this, "Экспорт тайлами");
+    if (dirPath.isEmpty()) return;
+
+    SceneExporter exporter(scene);
+    if (!exporter.exportPyramid(dirPath)) {
+        QMessageBox::warning(this, "Ошибка", exporter.lastError());
+    }
+}
+
+bool MainWindow::canRestore(QString *error) const {
+    // Restored shapes keep their ids, which would collide with anything
+    // the script has created already.
+    if (scene->shapeCount() > 0) {
+        *error = "the scene must be empty before any shapes are created";
+        return false;
+    }
+    return true;
+}
+
+bool MainWindow::runScript(const QString &fileName) {
+    auto parseIds = [](const QStringList &args, QVector<int> *ids, QString *error) {
+        for (const QString &arg : args) {
+            bool ok;
+            int id = arg.toInt(&ok);
+            if (!ok) {
+                *error = "invalid id " + arg;
+                return false;
+            }
+            ids->append(id);
+        }
+        return true;
+    };
+
+    ScriptRunner runner;
+    // Without ID X Y a shape goes to a random position under the next free
+    // id; recorded traces pin both. Returns the new id, or -1.
+    auto addShape = [this](FigureKind kind, int sides, const QStringList &args, int first, QString *error) {
+        if (args.size() == first) {
+            switch (kind) {
+            case FigureKind::Rectangle: return scene->addRectangle();
+            case FigureKind::Ellipse: return scene->addEllipse();
+            default: return scene->addPolygon(sides);
+            }
+        }
+        bool idOk, xOk, yOk;
+        const int id = args.at(first).toInt(&idOk);
+        const qreal x = args.value(first + 1).toDouble(&xOk);
+        const qreal y = args.value(first + 2).toDouble(&yOk);
+        if (args.size() != first + 3 || !idOk || id < 0 || !xOk || !yOk) {
+            *error = "expected ID X Y";
+            return -1;
+        }
+        const int added = scene->addShape(kind, QPointF(x, y), sides, id);
+        if (added < 0) {
+            *error = QString("id %1 is taken").arg(id);
+        }
+        return added;
+    };
+    runner.addCommand("rectangle", 0, "[ID X Y]", [addShape](const QStringList &args, QString *error) {
+        return addShape(FigureKind::Rectangle, 0, args, 0, error) >= 0;
+    });
+    runner.addCommand("ellipse", 0, "[ID X Y]", [addShape](const QStringList &args, QString *error) {
+        return addShape(FigureKind::Ellipse, 0, args, 0, error) >= 0;
+    });
+    runner.addCommand("polygon", 1, "SIDES [ID X Y]", [addShape](const QStringList &args, QString *error) {
+        const int sides = args.at(0).toInt();
+        if (sides < 3) {
+            *error = "a polygon needs at least 3 sides";
+            return false;
+        }
+        return addShape(FigureKind::Polygon, sides, args, 1, error) >= 0;
+    });
+    runner.addCommand("link", 2, "ID1 ID2", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        if (!parseIds(args.mid(0, 2), &ids, error)) {
+            *error = "usage: link ID1 ID2, with integer ids";
+            return false;
+        }
+        if (!scene->connectIds(ids.at(0), ids.at(1))) {
+            *error = "cannot link these shapes";
+            return false;
+        }
+        return true;
+    });
+    runner.addCommand("unlink", 2, "ID1 ID2", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        if (!parseIds(args.mid(0, 2), &ids, error)) {
+            *error = "usage: unlink ID1 ID2, with integer ids";
+            return false;
+        }
+        if (!scene->disconnectIds(ids.at(0), ids.at(1))) {
+            *error = "no such connection";
+            return false;
+        }
+        return true;
+    });
+    // What the connection button and "delete selected" do, for replayed
+    // traces: both act on the selection the replayed clicks built.
+    runner.addCommand("connect-mode", 0, "", [this](const QStringList &, QString *) {
+        scene->startConnectionMode();
+        return true;
+    });
+    runner.addCommand("delete-selected", 0, "", [this](const QStringList &, QString *) {
+        scene->deleteSelected();
+        return true;
+    });
+    runner.addCommand("filter", 2, "type|id VALUE", [this](const QStringList &args, QString *) {
+        scene->filterShapes(args.at(0), args.at(1));
+        return true;
+    });
+    runner.addCommand("delete", 1, "ID...", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        if (!parseIds(args, &ids, error)) {
+            *error = "usage: delete ID..., with integer ids";
+            return false;
+        }
+        scene->deleteIds(ids);
+        return true;
+    });
+    SceneCommands::addTransforms(runner, [this](const QTransform &transform) {
+        scene->transformShapes(scene->nodeStore().ids(), transform);
+    });
+    SceneCommands::addLayout(runner, scene);
+    runner.addCommand("autosave", 1, "DIR", [this](const QStringList &args, QString *error) {
+        if (!canRestore(error)) {
+            return false;
+        }
+        if (!startAutosave(args.at(0))) {
+            *error = "autosave is already on or could not be started";
+            return false;
+        }
+        return true;
+    });
+    runner.addCommand("autosave-flush", 0, "[compact]", [this](const QStringList &args, QString *error) {
+        if (!journal) {
+            *error = "autosave is off";
+            return false;
+        }
+        journal->flush(args.value(0) == "compact");
+        const ChangeJournal::Stats stats = journal->stats();
+        QTextStream(stdout) << "journal: " << stats.written << " records written, "
+                            << stats.compactions << " compactions, " << stats.journalBytes << " B pending\n";
+        return journal->lastError().isEmpty();
+    });
+    SceneCommands::addChurn<CustomGraphicsItem, ConnectionLine>(runner, [this](int count) {
+        QVector<int> ids(count);
+        scene->setJournal(nullptr);
+        for (int i = 0; i < count; ++i) {
+            ids[i] = scene->addRectangle();
+        }
+        for (int i = 1; i < count; ++i) {
+            scene->connectIds(ids[i - 1], ids[i]);
+        }
+        scene->deleteIds(ids);
+        scene->setJournal(journal);
+    });
+    runner.addCommand("export", 1, "FILE", [this](const QStringList &args, QString *error) {
+        SceneExporter exporter(scene);
+        if (!exporter.exportImage(args.at(0))) {
+            *error = exporter.lastError();
+            return false;
+        }
+        return true;
+    });
+    runner.addCommand("export-tiles", 1, "DIR", [this](const QStringList &args, QString *error) {
+        SceneExporter exporter(scene);
+        if (!exporter.exportPyramid(args.at(0))) {
+            *error = exporter.lastError();
+            return false;
+        }
+        return true;
+    });
+    TraceReplayer::addCommand(runner, scene, [this](const ChangeJournal::State &state, QString *error) {
+        if (!canRestore(error)) {
+            return false;
+        }
+        scene->restore(state);
+        return true;
+    });
+
+    bool ok = runner.run(fileName);
+    QTextStream out(stdout);
+    runner.printReport(out);
+    if (!runner.lastError().isEmpty()) {
+        QTextStream(stderr) << runner.lastError() << "\n";
+    }
+    return ok;
 }
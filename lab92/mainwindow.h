@@ -15,12 +15,18 @@
 #include <QHBoxLayout>
 #include "Scene.h"
 #include "ShapeModel.h"
+#include "perfview.h"
+#include "changejournal.h"
+#include "tracerecorder.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget *parent = nullptr);
+    explicit MainWindow(QWidget *parent = nullptr, bool batchMode = false);
+    ~MainWindow() override;
+
+    bool runScript(const QString &fileName);
 
 private slots:
     void addRectangle();
@@ -29,10 +35,14 @@ private slots:
     void addConnection();
     void deleteSelected();
     void filterShapes();
+    void exportImage();
+    void exportTiles();
+    void toggleLayout();
+    void startConnectionMode();
 
 private:
     Scene *scene;
-    QGraphicsView *view;
+    PerfView *view;
     QTableView *tableView;
     ShapeModel *model;
     QPushButton *addRectButton;
@@ -41,9 +51,19 @@ private:
     QPushButton *addConnectionButton;
     QPushButton *deleteButton;
     QPushButton *filterButton;
+    QPushButton *exportImageButton;
+    QPushButton *exportTilesButton;
+    QPushButton *layoutButton;
     QLineEdit *filterValueLineEdit;
     QComboBox *filterTypeComboBox;
     QLineEdit *polygonSidesLineEdit;
+    ChangeJournal *journal = nullptr;
+    TraceRecorder *recorder;
+    bool batchMode;
+
+    bool startAutosave(const QString &directory);
+    bool canRestore(QString *error) const;
+    void recordCreated(const QString &command, int id);
 };
 
 #endif // MAINWINDOW_H
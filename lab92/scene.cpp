@@ -9,69 +9,165 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QRandomGenerator>
 #include "customgraphicsitem.h"
+#include "perfstats.h"
 
 Scene::Scene(QObject *parent)
-    : QGraphicsScene(parent), connectionMode(false), shapeCounter(0) {}
-
-void Scene::addRectangle() {
-    CustomGraphicsItem *rect = new CustomGraphicsItem();
-    QGraphicsRectItem *shape = new QGraphicsRectItem(0, 0, 100, 50, rect);
-    shape->setPen(QPen(Qt::blue, 2));
+    : QGraphicsScene(parent), shapeCounter(0), connectionMode(false),
+      // Rectangle and ellipse shapes hang down and right from the group's
+      // origin; polygons are centred on it.
+      edgeKernel({ { 0.5f, 0.5f }, { 0.5f, 0.5f }, { 0.0f, 0.0f }, { 0.0f, 0.0f } }),
+      staleLines(&nodes, [](ConnectionLine *line) { return qMakePair(line->fromId, line->toId); }),
+      layout(&nodes),
+      selectionTool(this) {
+    connect(&layout, &NodeLayout::positionsUpdated, this,
+            [this](const QVector<int> &ids, const QVector<QPointF> &positions) {
+        setShapePositions(ids, positions, false);
+    });
+    connect(&layout, &NodeLayout::finished, this, &Scene::onLayoutFinished);
+}
 
-    rect->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable);
+int Scene::registerShape(CustomGraphicsItem *item, FigureKind kind, const QSizeF &size, int sides, int id) {
+    item->setFlag(QGraphicsItem::ItemSendsGeometryChanges);
 
-    int x = QRandomGenerator::global()->bounded(0, width());
-    int y = QRandomGenerator::global()->bounded(0, height());
-    rect->setPos(x, y);
-
-    addItem(rect);
-    itemIds[rect] = shapeCounter++;
-    itemTypes[rect] = "Rectangle";
-    connections[rect] = {};
+    if (id < 0) {
+        id = shapeCounter;
+    } else if (nodes.slotOf(id) >= 0) {
+        // views is indexed by node slot; a second item for one id would
+        // shift every later slot against it.
+        return -1;
+    }
+    shapeCounter = qMax(shapeCounter, id + 1);
+    item->setNodeId(id);
+    nodes.add(id, kind, item->pos(), size, sides);
+    views.append(item);
+    grid.insert(id, item->sceneBoundingRect().center());
+    if (journal) {
+        journal->recordAdd(id, kind, item->pos(), size, sides);
+    }
+    return id;
 }
 
-void Scene::addEllipse() {
-    CustomGraphicsItem *ellipse = new CustomGraphicsItem();
-    QGraphicsEllipseItem *shape = new QGraphicsEllipseItem(0, 0, 80, 50, ellipse);
-    shape->setPen(QPen(Qt::red, 2));
-
-    ellipse->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable);
+CustomGraphicsItem *Scene::shapeOf(QGraphicsItem *item) {
+    while (item && !dynamic_cast<CustomGraphicsItem *>(item)) {
+        item = item->parentItem();
+    }
+    return static_cast<CustomGraphicsItem *>(item);
+}
 
-    int x = QRandomGenerator::global()->bounded(0, width());
-    int y = QRandomGenerator::global()->bounded(0, height());
-    ellipse->setPos(x, y);
+CustomGraphicsItem *Scene::itemById(int id) const {
+    const int slot = nodes.slotOf(id);
+    return slot < 0 ? nullptr : views.at(slot);
+}
 
-    addItem(ellipse);
-    itemIds[ellipse] = shapeCounter++;
-    itemTypes[ellipse] = "Ellipse";
-    connections[ellipse] = {};
+void Scene::itemMoved(CustomGraphicsItem *item) {
+    const int slot = nodes.slotOf(item->nodeId());
+    if (slot >= 0) {
+        nodes.setPosition(slot, item->pos());
+        grid.move(item->nodeId(), item->sceneBoundingRect().center());
+        markStale(item);
+        if (journal && recordingMoves) {
+            journal->recordMove(item->nodeId(), item->pos());
+        }
+    }
 }
 
-void Scene::addPolygon(int sides) {
-    if (sides < 3) return;
+void Scene::markStale(CustomGraphicsItem *item) {
+    for (auto &conn : item->connections) {
+        staleLines.mark(conn.second);
+    }
+}
 
-    CustomGraphicsItem *polygonItem = new CustomGraphicsItem();
-    QPolygonF polygon;
-    qreal angleStep = 360.0 / sides;
+void Scene::selectIds(const QVector<int> &ids) {
+    clearSelection();
+    for (int id : ids) {
+        if (CustomGraphicsItem *item = itemById(id)) {
+            item->setSelected(true);
+        }
+    }
+}
 
-    for (int i = 0; i < sides; ++i) {
-        qreal angle = qDegreesToRadians(angleStep * i);
-        polygon << QPointF(50 * cos(angle), 50 * sin(angle));
+QSizeF Scene::shapeSize(FigureKind kind) {
+    switch (kind) {
+    case FigureKind::Rectangle: return QSizeF(100, 50);
+    case FigureKind::Ellipse: return QSizeF(80, 50);
+    case FigureKind::Polygon: return QSizeF(100, 100);
+    default: return QSizeF();
     }
+}
 
-    QGraphicsPolygonItem *shape = new QGraphicsPolygonItem(polygon, polygonItem);
-    shape->setPen(QPen(Qt::green, 2));
+int Scene::addShape(FigureKind kind, const QPointF &pos, int sides, int id) {
+    CustomGraphicsItem *item = new CustomGraphicsItem();
+    const QSizeF size = shapeSize(kind);
+    switch (kind) {
+    case FigureKind::Rectangle: {
+        QGraphicsRectItem *shape = new QGraphicsRectItem(QRectF(QPointF(0, 0), size), item);
+        shape->setPen(QPen(Qt::blue, 2));
+        break;
+    }
+    case FigureKind::Ellipse: {
+        QGraphicsEllipseItem *shape = new QGraphicsEllipseItem(QRectF(QPointF(0, 0), size), item);
+        shape->setPen(QPen(Qt::red, 2));
+        break;
+    }
+    case FigureKind::Polygon: {
+        if (sides < 3) {
+            delete item;
+            return -1;
+        }
+        PolygonShape *shape = new PolygonShape(sides, 50, item);
+        shape->setPen(QPen(Qt::green, 2));
+        break;
+    }
+    default:
+        delete item;
+        return -1;
+    }
 
-    polygonItem->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable);
+    item->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable);
+    item->setPos(pos);
+    addItem(item);
+    const int registered = registerShape(item, kind, size, sides, id);
+    if (registered < 0) {
+        delete item;
+    }
+    return registered;
+}
 
+QPointF Scene::randomPosition() const {
     int x = QRandomGenerator::global()->bounded(0, width());
     int y = QRandomGenerator::global()->bounded(0, height());
-    polygonItem->setPos(x, y);
+    return QPointF(x, y);
+}
+
+int Scene::addRectangle() {
+    return addShape(FigureKind::Rectangle, randomPosition());
+}
+
+int Scene::addEllipse() {
+    return addShape(FigureKind::Ellipse, randomPosition());
+}
 
-    addItem(polygonItem);
-    itemIds[polygonItem] = shapeCounter++;
-    itemTypes[polygonItem] = "Polygon";
-    connections[polygonItem] = {};
+int Scene::addPolygon(int sides) {
+    if (sides < 3) return -1;
+    return addShape(FigureKind::Polygon, randomPosition(), sides);
+}
+
+void Scene::restore(const ChangeJournal::State &state) {
+    for (auto it = state.nodes.constBegin(); it != state.nodes.constEnd(); ++it) {
+        addShape(it.value().kind, it.value().pos, it.value().sides, it.key());
+    }
+    for (quint64 key : state.links) {
+        const QPair<int, int> link = ChangeJournal::State::linkIds(key);
+        connectIds(link.first, link.second);
+    }
+}
+
+ChangeJournal::State Scene::snapshot() const {
+    ChangeJournal::State state = ChangeJournal::State::fromNodes(nodes);
+    for (auto it = edges.constBegin(); it != edges.constEnd(); ++it) {
+        state.links.insert(it.key());
+    }
+    return state;
 }
 
 void Scene::startConnectionMode() {
@@ -79,18 +175,54 @@ void Scene::startConnectionMode() {
     clearSelectedItems();
 }
 
-void Scene::addConnection(CustomGraphicsItem *item1, CustomGraphicsItem *item2) {
-    if (!item1 || !item2 || item1 == item2) return;
+bool Scene::addConnection(CustomGraphicsItem *item1, CustomGraphicsItem *item2) {
+    if (!item1 || !item2 || item1 == item2) return false;
+
+    const quint64 key = ChangeJournal::State::linkKey(item1->nodeId(), item2->nodeId());
+    if (edges.contains(key)) return false;
 
     QPointF point1 = item1->mapToScene(item1->boundingRect().center());
     QPointF point2 = item2->mapToScene(item2->boundingRect().center());
 
-    QGraphicsLineItem *line = new QGraphicsLineItem(QLineF(point1, point2));
+    ConnectionLine *line = new ConnectionLine(QLineF(point1, point2));
     line->setPen(QPen(Qt::black, 2));
+    line->setVisible(item1->isVisible() && item2->isVisible());
+    line->fromId = item1->nodeId();
+    line->toId = item2->nodeId();
     addItem(line);
 
+    edges.insert(key, line);
     item1->addConnection(item2, line);
     item2->addConnection(item1, line);
+    if (journal) {
+        journal->recordLink(item1->nodeId(), item2->nodeId());
+    }
+    return true;
+}
+
+bool Scene::connectIds(int id1, int id2) {
+    return addConnection(itemById(id1), itemById(id2));
+}
+
+bool Scene::disconnectIds(int id1, int id2) {
+    ConnectionLine *line = edges.take(ChangeJournal::State::linkKey(id1, id2));
+    if (!line) return false;
+
+    CustomGraphicsItem *item1 = itemById(id1);
+    CustomGraphicsItem *item2 = itemById(id2);
+    item1->removeConnection(item2);
+    item2->removeConnection(item1);
+    staleLines.drop(line);
+    delete line;
+    if (journal) {
+        journal->recordUnlink(id1, id2);
+    }
+    return true;
+}
+
+void Scene::deleteIds(const QVector<int> &ids) {
+    selectIds(ids);
+    deleteSelected();
 }
 
 void Scene::clearSelectedItems() {
@@ -101,46 +233,64 @@ void Scene::clearSelectedItems() {
 }
 
 void Scene::deleteSelected() {
+    QVector<int> removed;
     for (auto item : selectedItems()) {
         auto customItem = dynamic_cast<CustomGraphicsItem *>(item);
         if (customItem) {
             for (auto &conn : customItem->connections) {
                 CustomGraphicsItem *other = conn.first;
-                QGraphicsLineItem *lineItem = conn.second;
-
-                if (lineItem) {
-                    removeItem(lineItem);
-                    delete lineItem;
-                }
+                ConnectionLine *lineItem = conn.second;
 
                 other->removeConnection(customItem);
+                edges.remove(ChangeJournal::State::linkKey(lineItem->fromId, lineItem->toId));
+                staleLines.drop(lineItem);
+                delete lineItem;
             }
             customItem->connections.clear();
         }
 
+        const int slot = customItem ? nodes.slotOf(customItem->nodeId()) : -1;
+        if (slot >= 0) {
+            // Mirror the store's swap-remove so views stay slot-aligned.
+            views[slot] = views.last();
+            views.removeLast();
+            nodes.remove(customItem->nodeId());
+            grid.remove(customItem->nodeId());
+            removed.append(customItem->nodeId());
+        }
         removeItem(item);
         delete item;
     }
+
+    if (journal && !removed.isEmpty()) {
+        journal->recordDelete(removed);
+    }
+
+    if (nodes.size() == 0) {
+        CustomGraphicsItem::trimPool();
+        ConnectionLine::trimPool();
+    }
 }
 
 
 void Scene::mousePressEvent(QGraphicsSceneMouseEvent *event) {
     auto item = itemAt(event->scenePos(), QTransform());
 
+    SelectionTool::Mode mode = SelectionTool::modeFor(event->modifiers());
+    if (!connectionMode && !item && mode != SelectionTool::None && event->button() == Qt::LeftButton) {
+        selectionTool.begin(mode, event->scenePos());
+        return;
+    }
+
     if (connectionMode) {
-        if (item && !selectedItemsForConnection.contains(item)) {
-            item->setSelected(true);
-            selectedItemsForConnection.append(item);
+        // Clicks land on a shape's child items or on lines; only shapes
+        // can be connected.
+        CustomGraphicsItem *shape = shapeOf(item);
+        if (shape && !selectedItemsForConnection.contains(shape)) {
+            shape->setSelected(true);
+            selectedItemsForConnection.append(shape);
             if (selectedItemsForConnection.size() == 2) {
-
-                QGraphicsItem *item1 = selectedItemsForConnection[0];
-                QGraphicsItem *item2 = selectedItemsForConnection[1];
-                QLineF line(item1->sceneBoundingRect().center(), item2->sceneBoundingRect().center());
-                QGraphicsLineItem *connection = new QGraphicsLineItem(line);
-                connection->setPen(QPen(Qt::black, 2));
-                addItem(connection);
-                connections[item1].append(connection);
-                connections[item2].append(connection);
+                addConnection(selectedItemsForConnection[0], selectedItemsForConnection[1]);
                 clearSelectedItems();
                 connectionMode = false;
             }
@@ -154,30 +304,109 @@ void Scene::mousePressEvent(QGraphicsSceneMouseEvent *event) {
 }
 
 void Scene::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
+    static const int category = PerfStats::instance().category("Scene::mouseMoveEvent");
+    PerfTimer timer(category);
+
+    if (selectionTool.isActive()) {
+        selectionTool.update(event->scenePos());
+        return;
+    }
+
     QGraphicsScene::mouseMoveEvent(event);
     QGraphicsItem *item = itemAt(event->scenePos(), QTransform());
     if (item && item->isSelected() && event->buttons() & Qt::LeftButton) {
         item->setPos(event->scenePos());
-
-        auto customItem = dynamic_cast<CustomGraphicsItem *>(item);
-        if (customItem) {
-            for (auto &pair : customItem->connections) {
-                QPointF point1 = customItem->mapToScene(customItem->boundingRect().center());
-                QPointF point2 = pair.first->mapToScene(pair.first->boundingRect().center());
-                pair.second->setLine(QLineF(point1, point2));
-            }
-        }
     }
     QGraphicsScene::mouseMoveEvent(event);
     updateConnections();
 }
+void Scene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event) {
+    if (selectionTool.isActive()) {
+        SelectionTool::Mode mode = selectionTool.mode();
+        QPolygonF area = selectionTool.finish();
+        selectIds(mode == SelectionTool::Rectangle ? grid.query(area.boundingRect()) : grid.query(area));
+        return;
+    }
+
+    QGraphicsScene::mouseReleaseEvent(event);
+}
+
+int Scene::connectionCount() const {
+    return edges.size();
+}
+
 void Scene::updateConnections() {
-    for (auto item : items()) {
-        auto customItem = dynamic_cast<CustomGraphicsItem *>(item);
-        if (customItem) {
-            customItem->updateConnections();
+    LazyGeometry::refreshVisible(this);
+}
+
+void Scene::refreshGeometry(const QRectF &sceneRect) {
+    if (staleLines.isEmpty()) {
+        return;
+    }
+
+    static const int category = PerfStats::instance().category("Scene::refreshGeometry");
+    PerfTimer timer(category);
+
+    staleLines.refresh(sceneRect, edgeKernel);
+}
+
+void Scene::moveShapes(const QVector<int> &ids, const QPointF &delta) {
+    transformShapes(ids, QTransform::fromTranslate(delta.x(), delta.y()));
+}
+
+void Scene::transformShapes(const QVector<int> &ids, const QTransform &transform) {
+    static const int category = PerfStats::instance().category("Scene::transformShapes");
+    PerfTimer timer(category);
+
+    // itemChange() keeps the node store and grid in step with each move.
+    for (int id : ids) {
+        if (CustomGraphicsItem *item = itemById(id)) {
+            item->setPos(transform.map(item->pos()));
+        }
+    }
+    updateConnections();
+}
+
+void Scene::setShapePositions(const QVector<int> &ids, const QVector<QPointF> &positions, bool record) {
+    static const int category = PerfStats::instance().category("Scene::setShapePositions");
+    PerfTimer timer(category);
+
+    recordingMoves = record;
+    for (int i = 0; i < ids.size() && i < positions.size(); ++i) {
+        if (CustomGraphicsItem *item = itemById(ids.at(i))) {
+            item->setPos(positions.at(i));
         }
     }
+    recordingMoves = true;
+    updateConnections();
+}
+
+bool Scene::startLayout(bool newOnly) {
+    if (layout.isRunning()) {
+        return false;
+    }
+
+    QVector<QPair<int, int>> links;
+    links.reserve(edges.size());
+    for (auto it = edges.constBegin(); it != edges.constEnd(); ++it) {
+        links.append(ChangeJournal::State::linkIds(it.key()));
+    }
+
+    return layout.start(newOnly, links);
+}
+
+void Scene::cancelLayout() {
+    layout.cancel();
+}
+
+void Scene::onLayoutFinished(int iterations, bool canceled) {
+    if (journal) {
+        QVector<int> ids;
+        QVector<QPointF> positions;
+        layout.lastMoves(&ids, &positions);
+        journal->recordMoves(ids, positions);
+    }
+    emit layoutFinished(iterations, canceled);
 }
 
 /*
@@ -192,14 +421,26 @@ void Scene::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
 */
 
 void Scene::filterShapes(const QString &filterType, const QString &filterValue) {
-    for (auto item : items()) {
+    // Decided from the node arrays; the type name is parsed once, not
+    // compared per shape.
+    const FigureKind kind = figureKindFromName(filterValue);
+    bool ok = false;
+    const int id = filterValue.toInt(&ok);
+
+    for (int slot = 0; slot < nodes.size(); ++slot) {
         bool visible = true;
         if (filterType == "type") {
-            if (itemTypes[item] != filterValue) visible = false;
+            visible = nodes.kindAt(slot) == kind;
         } else if (filterType == "id") {
-            if (QString::number(itemIds[item]) != filterValue) visible = false;
+            visible = ok && nodes.idAt(slot) == id;
         }
+        views.at(slot)->setVisible(visible);
+    }
 
-        item->setVisible(visible);
+    for (CustomGraphicsItem *item : views) {
+        for (auto &conn : item->connections) {
+            conn.second->setVisible(item->isVisible() && conn.first->isVisible());
+        }
     }
+    updateConnections();
 }
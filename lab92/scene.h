@@ -5,40 +5,94 @@
 #include <QGraphicsItem>
 #include <QGraphicsLineItem>
 #include <QGraphicsPolygonItem>
-#include <QMap>
+#include <QHash>
 #include <QGraphicsRectItem>
 #include <QGraphicsEllipseItem>
 #include <QSet>
+#include <QTransform>
 #include "customgraphicsitem.h"
+#include "spatialgrid.h"
+#include "selectiontool.h"
+#include "nodestore.h"
+#include "edgekernel.h"
+#include "nodelayout.h"
+#include "changejournal.h"
+#include "lazygeometry.h"
 
-class Scene : public QGraphicsScene {
+// Connections of a moved shape are only marked stale; their geometry is
+// recomputed where it is on screen or about to be drawn.
+class Scene : public QGraphicsScene, public LazyGeometry {
     Q_OBJECT
 
 public:
     explicit Scene(QObject *parent = nullptr);
 
-    void addRectangle();
-    void addEllipse();
-    void addPolygon(int sides);
+    // Mutations made while a journal is set are recorded to it.
+    void setJournal(ChangeJournal *journal) { this->journal = journal; }
+    void restore(const ChangeJournal::State &state);
+    ChangeJournal::State snapshot() const;
+
+    int addRectangle();
+    int addEllipse();
+    int addPolygon(int sides);
+    int addShape(FigureKind kind, const QPointF &pos, int sides = 0, int id = -1);
     void startConnectionMode();
     void clearSelectedItems();
     void deleteSelected();
-    void addConnection(CustomGraphicsItem *item1, CustomGraphicsItem *item2);
+    bool addConnection(CustomGraphicsItem *item1, CustomGraphicsItem *item2);
+    bool connectIds(int id1, int id2);
+    bool disconnectIds(int id1, int id2);
+    void deleteIds(const QVector<int> &ids);
     void filterShapes(const QString &filterType, const QString &filterValue);
     void updateConnections();
+    void refreshGeometry(const QRectF &sceneRect) override;
+    void moveShapes(const QVector<int> &ids, const QPointF &delta);
+    void transformShapes(const QVector<int> &ids, const QTransform &transform);
+    // record is false for the frames a running layout streams; the layout
+    // records its result once it finishes.
+    void setShapePositions(const QVector<int> &ids, const QVector<QPointF> &positions, bool record = true);
+    bool startLayout(bool newOnly);
+    void cancelLayout();
+    bool isLayoutRunning() const { return layout.isRunning(); }
+    void itemMoved(CustomGraphicsItem *item);
+    int shapeCount() const { return nodes.size(); }
+    const NodeStore &nodeStore() const { return nodes; }
+    int connectionCount() const;
+
+signals:
+    void layoutFinished(int iterations, bool canceled);
 
 protected:
     void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
 private:
-    QList<QGraphicsItem *> selectedItemsForConnection;
+    int registerShape(CustomGraphicsItem *item, FigureKind kind, const QSizeF &size, int sides, int id);
+    QPointF randomPosition() const;
+    static QSizeF shapeSize(FigureKind kind);
+    CustomGraphicsItem *itemById(int id) const;
+    static CustomGraphicsItem *shapeOf(QGraphicsItem *item);
+    void selectIds(const QVector<int> &ids);
+    void markStale(CustomGraphicsItem *item);
+    void onLayoutFinished(int iterations, bool canceled);
+
+    QList<CustomGraphicsItem *> selectedItemsForConnection;
     int shapeCounter;
-    QMap<QGraphicsItem *, int> itemIds;
-    QMap<QGraphicsItem *, QString> itemTypes;
-    QMap<QGraphicsItem *, QList<QGraphicsLineItem *>> connections;
+    // Every connection once, keyed by its unordered id pair; each shape's
+    // connections list is the incident list into it.
+    QHash<quint64, ConnectionLine *> edges;
     bool connectionMode = false;
     QList<CustomGraphicsItem *> connectionTargets;
+    NodeStore nodes;
+    QVector<CustomGraphicsItem *> views;
+    EdgeKernel edgeKernel;
+    StaleLines<ConnectionLine> staleLines;
+    NodeLayout layout;
+    ChangeJournal *journal = nullptr;
+    bool recordingMoves = true;
+    SpatialGrid grid;
+    SelectionTool selectionTool;
 };
 
 #endif // SCENE_H
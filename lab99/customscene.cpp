@@ -1,240 +1,570 @@
 #include "customscene.h"
 #include <QDebug>
-#include <QSqlQuery>
-#include <QSqlError>
+#include <QSet>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include "perfstats.h"
+
+namespace {
+
+struct ConnectionQueryResult {
+    std::shared_ptr<ConnectionGraph> graph;
+    QVector<int> ids;
+};
+
+}
 
 CustomScene::CustomScene(QObject *parent)
-    : QGraphicsScene(parent) {}
+    : QGraphicsScene(parent),
+      // Rectangles extend up and left from their position; ellipses and
+      // polygons are centred on it. See FigureItem::localRect().
+      edgeKernel({ { -0.5f, -0.5f }, { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f } }),
+      staleLines(&nodes, [](CustomLine *line) { return qMakePair(line->startItem()->id(), line->endItem()->id()); }),
+      layout(&nodes),
+      selectionTool(this) {
+    connect(&layout, &NodeLayout::positionsUpdated, this,
+            [this](const QVector<int> &ids, const QVector<QPointF> &positions) {
+        setFigurePositions(ids, positions, false);
+    });
+    connect(&layout, &NodeLayout::finished, this, &CustomScene::onLayoutFinished);
+}
 
-void CustomScene::mousePressEvent(QGraphicsSceneMouseEvent *event) {
-    QGraphicsItem *item = itemAt(event->scenePos(), QTransform());
-    if (item) {
-        selectedItem = item;
-        selectedItemId = item->data(0).toInt();
-        qDebug() << "Item selected: ID =" << selectedItemId;
-        emit itemSelected(selectedItemId);
-        maxZValue += 1;
-        item->setZValue(maxZValue);
-    } else {
-        selectedItem = nullptr;
-        selectedItemId = -1;
+FigureItem *CustomScene::addFigure(int id, FigureKind kind, const QSizeF &size, int sides) {
+    if (FigureItem *existing = itemById(id)) {
+        return existing;
     }
-    QGraphicsScene::mousePressEvent(event);
+
+    nodes.add(id, kind, QPointF(), size, sides);
+    FigureItem *item = new FigureItem(id, &nodes);
+    views.append(item);
+    addItem(item);
+    grid.insert(id, item->sceneBoundingRect().center());
+    if (journal) {
+        journal->recordAdd(id, kind, item->pos(), size, sides);
+    }
+    return item;
 }
 
-void CustomScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
-    if (selectedItem && event->buttons() & Qt::LeftButton) {
-        selectedItem->setPos(event->scenePos());
+FigureItem *CustomScene::itemById(int id) const {
+    const int slot = nodes.slotOf(id);
+    return slot < 0 ? nullptr : views.at(slot);
+}
 
+ChangeJournal::State CustomScene::snapshot() const {
+    ChangeJournal::State state = ChangeJournal::State::fromNodes(nodes);
+    state.links = linkKeys;
+    return state;
+}
 
-        for (CustomLine *line : lines) {
-            if (line->startItem() == selectedItem || line->endItem() == selectedItem) {
-                line->updateLine();
-            }
+void CustomScene::unregisterItem(int id) {
+    const int slot = nodes.slotOf(id);
+    if (slot < 0) {
+        return;
+    }
+
+    // Mirror the store's swap-remove so views stay slot-aligned.
+    views[slot] = views.last();
+    views.removeLast();
+    nodes.remove(id);
+    degrees.remove(id);
+    grid.remove(id);
+    invalidateGraph();
+}
+
+void CustomScene::moveFigures(const QVector<int> &ids, const QPointF &delta) {
+    transformFigures(ids, QTransform::fromTranslate(delta.x(), delta.y()));
+}
+
+void CustomScene::transformFigures(const QVector<int> &ids, const QTransform &transform) {
+    static const int category = PerfStats::instance().category("CustomScene::transformFigures");
+    PerfTimer timer(category);
+
+    QVector<int> movedIds;
+    QVector<QPointF> positions;
+    for (int id : ids) {
+        const int slot = nodes.slotOf(id);
+        if (slot < 0) {
+            continue;
+        }
+        FigureItem *item = views.at(slot);
+        item->setPos(transform.map(item->pos()));
+        grid.move(id, item->sceneBoundingRect().center());
+        markStale(id);
+        if (journal) {
+            movedIds.append(id);
+            positions.append(item->pos());
         }
+    }
 
-        emit itemMoved(selectedItemId, event->scenePos());
+    LazyGeometry::refreshVisible(this);
+    if (journal) {
+        journal->recordMoves(movedIds, positions);
     }
+}
 
-    QGraphicsScene::mouseMoveEvent(event);
+void CustomScene::setFigurePositions(const QVector<int> &ids, const QVector<QPointF> &positions, bool record) {
+    static const int category = PerfStats::instance().category("CustomScene::setFigurePositions");
+    PerfTimer timer(category);
 
-    QGraphicsItem* item = itemAt(event->scenePos(), QTransform());
-    if (item && item->isSelected()) {
-        item->setZValue(maxZValue + 1);
+    for (int i = 0; i < ids.size() && i < positions.size(); ++i) {
+        const int slot = nodes.slotOf(ids.at(i));
+        if (slot < 0) {
+            continue;
+        }
+        FigureItem *item = views.at(slot);
+        item->setPos(positions.at(i));
+        grid.move(ids.at(i), item->sceneBoundingRect().center());
+        markStale(ids.at(i));
+    }
 
-        maxZValue = item->zValue();
+    LazyGeometry::refreshVisible(this);
+    if (journal && record) {
+        journal->recordMoves(ids, positions);
     }
 }
 
-void CustomScene::createPair(int id1, int id2) {
-    if (id1 == id2) {
-        qWarning() << "Cannot create a pair with the same figure.";
-        return;
+bool CustomScene::startLayout(bool newOnly) {
+    if (layout.isRunning()) {
+        return false;
     }
 
-    QGraphicsItem *item1 = nullptr;
-    QGraphicsItem *item2 = nullptr;
+    return layout.start(newOnly, edgeList());
+}
+
+void CustomScene::cancelLayout() {
+    layout.cancel();
+}
 
-    for (QGraphicsItem *item : items()) {
-        int itemId = item->data(0).toInt();
-        if (itemId == id1) item1 = item;
-        if (itemId == id2) item2 = item;
-        if (item1 && item2) break;
+void CustomScene::onLayoutFinished(int iterations, bool canceled) {
+    if (journal) {
+        QVector<int> ids;
+        QVector<QPointF> positions;
+        layout.lastMoves(&ids, &positions);
+        journal->recordMoves(ids, positions);
     }
+    emit layoutFinished(iterations, canceled);
+}
 
-    if (!item1 || !item2) {
-        qWarning() << "One or both items not found for IDs:" << id1 << id2;
+void CustomScene::refreshGeometry(const QRectF &sceneRect) {
+    if (staleLines.isEmpty()) {
         return;
     }
 
-    CustomLine *line = new CustomLine(item1, item2, this);
-    lines.append(line);
+    static const int category = PerfStats::instance().category("CustomScene::refreshGeometry");
+    PerfTimer timer(category);
 
-    QSqlQuery query;
-    QString relatedIds1, relatedIds2;
+    // Endpoints come from the store's arrays, off the GUI thread for large
+    // batches.
+    staleLines.refresh(sceneRect, edgeKernel);
+}
 
-    query.prepare("SELECT related_ids FROM figures WHERE id = ?");
-    query.addBindValue(id1);
-    if (query.exec() && query.next()) {
-        relatedIds1 = query.value(0).toString();
-    } else {
-        qWarning() << "Failed to fetch related IDs for figure" << id1 << ":" << query.lastError().text();
+void CustomScene::markStale(int id) {
+    ensureIncidentIndex();
+    const auto it = incidentLines.constFind(id);
+    if (it == incidentLines.constEnd()) {
+        return;
     }
-
-    query.prepare("SELECT related_ids FROM figures WHERE id = ?");
-    query.addBindValue(id2);
-    if (query.exec() && query.next()) {
-        relatedIds2 = query.value(0).toString();
-    } else {
-        qWarning() << "Failed to fetch related IDs for figure" << id2 << ":" << query.lastError().text();
+    for (CustomLine *line : it.value()) {
+        staleLines.mark(line);
     }
+}
 
-    if (!relatedIds1.split(",").contains(QString::number(id2))) {
-        relatedIds1 += (relatedIds1.isEmpty() ? "" : ",") + QString::number(id2);
+// Built on the first move after the links change, like the connection
+// graph; drags then touch only the lines of the figures that move.
+void CustomScene::ensureIncidentIndex() {
+    if (!incidentDirty) {
+        return;
     }
+    incidentLines.clear();
+    for (CustomLine *line : lines) {
+        incidentLines[line->startItem()->id()].append(line);
+        incidentLines[line->endItem()->id()].append(line);
+    }
+    incidentDirty = false;
+}
 
-    if (!relatedIds2.split(",").contains(QString::number(id1))) {
-        relatedIds2 += (relatedIds2.isEmpty() ? "" : ",") + QString::number(id1);
+bool CustomScene::isHidden(int id) const {
+    const int slot = nodes.slotOf(id);
+    return slot >= 0 && nodes.testFlag(slot, NodeStore::Hidden);
+}
+
+void CustomScene::applyFilter(const FigureFilter &newFilter) {
+    filter = newFilter;
+    for (int slot = 0; slot < nodes.size(); ++slot) {
+        views.at(slot)->setVisible(figureVisible(slot));
     }
 
-    query.prepare("UPDATE figures SET related_ids = ? WHERE id = ?");
-    query.addBindValue(relatedIds1);
-    query.addBindValue(id1);
-    if (!query.exec()) {
-        qWarning() << "Failed to update related IDs for figure" << id1 << ":" << query.lastError().text();
+    updateLineVisibility();
+}
+
+void CustomScene::setHidden(const QVector<int> &ids, bool hidden) {
+    static const int category = PerfStats::instance().category("CustomScene::setHidden");
+    PerfTimer timer(category);
+
+    for (int id : ids) {
+        const int slot = nodes.slotOf(id);
+        if (slot < 0) {
+            continue;
+        }
+        nodes.setFlag(slot, NodeStore::Hidden, hidden);
+        views.at(slot)->setVisible(figureVisible(slot));
+    }
+    if (journal) {
+        journal->recordHidden(ids, hidden);
     }
 
-    query.prepare("UPDATE figures SET related_ids = ? WHERE id = ?");
-    query.addBindValue(relatedIds2);
-    query.addBindValue(id2);
-    if (!query.exec()) {
-        qWarning() << "Failed to update related IDs for figure" << id2 << ":" << query.lastError().text();
+    updateLineVisibility();
+}
+
+void CustomScene::showOnly(const QVector<int> &ids) {
+    shownOnly = QSet<int>(ids.begin(), ids.end());
+    showingOnly = true;
+    applyFilter(filter);
+}
+
+void CustomScene::hideInView(const QVector<int> &ids) {
+    for (int id : ids) {
+        const int slot = nodes.slotOf(id);
+        if (slot < 0) {
+            continue;
+        }
+        hiddenInView.insert(id);
+        views.at(slot)->setVisible(false);
     }
 
-    qDebug() << "Pair created between figures" << id1 << "and" << id2 << "and updated in the database.";
+    updateLineVisibility();
 }
 
-void CustomScene::deletePair(int id1, int id2) {
-    if (id1 == id2) {
-        qWarning() << "Cannot delete a pair with the same figure.";
+void CustomScene::showAll() {
+    if (!showingOnly && hiddenInView.isEmpty()) {
         return;
     }
+    shownOnly.clear();
+    showingOnly = false;
+    hiddenInView.clear();
+    applyFilter(filter);
+}
 
-    QGraphicsItem *item1 = nullptr;
-    QGraphicsItem *item2 = nullptr;
+bool CustomScene::figureVisible(int slot) const {
+    const int id = nodes.idAt(slot);
+    return !nodes.testFlag(slot, NodeStore::Hidden)
+            && (!showingOnly || shownOnly.contains(id))
+            && !hiddenInView.contains(id)
+            && filter.accepts(id, nodes.kindAt(slot), degrees.value(id) > 0);
+}
 
+void CustomScene::updateLineVisibility() {
+    for (CustomLine *line : lines) {
+        line->setVisible(line->startItem()->isVisible() && line->endItem()->isVisible());
+    }
+    LazyGeometry::refreshVisible(this);
+}
+
+void CustomScene::lineRemoved(CustomLine *line) {
+    const int id1 = line->startItem()->id();
+    const int id2 = line->endItem()->id();
+    --degrees[id1];
+    --degrees[id2];
+    linkKeys.remove(ChangeJournal::State::linkKey(id1, id2));
+    staleLines.drop(line);
+}
 
-    for (QGraphicsItem *item : items()) {
-        int itemId = item->data(0).toInt();
-        if (itemId == id1) item1 = item;
-        if (itemId == id2) item2 = item;
-        if (item1 && item2) break;
+void CustomScene::selectIds(const QVector<int> &ids) {
+    clearSelection();
+    for (int id : ids) {
+        if (QGraphicsItem *item = itemById(id)) {
+            item->setSelected(true);
+        }
     }
+}
 
-    if (!item1 || !item2) {
-        qWarning() << "One or both items not found for IDs:" << id1 << id2;
+void CustomScene::mousePressEvent(QGraphicsSceneMouseEvent *event) {
+    QGraphicsItem *item = itemAt(event->scenePos(), QTransform());
+
+    SelectionTool::Mode mode = SelectionTool::modeFor(event->modifiers());
+    if (!item && mode != SelectionTool::None && event->button() == Qt::LeftButton) {
+        selectionTool.begin(mode, event->scenePos());
         return;
     }
 
+    if (FigureItem *figure = qgraphicsitem_cast<FigureItem *>(item)) {
+        selectedItem = figure;
+        selectedItemId = figure->id();
+        qDebug() << "Item selected: ID =" << selectedItemId;
+        emit itemSelected(selectedItemId);
+        maxZValue += 1;
+        figure->setZValue(maxZValue);
+    } else {
+        selectedItem = nullptr;
+        selectedItemId = -1;
+    }
+    QGraphicsScene::mousePressEvent(event);
+}
 
-    auto it = lines.begin();
-    while (it != lines.end()) {
-        CustomLine *line = *it;
-        if ((line->startItem() == item1 && line->endItem() == item2) ||
-            (line->startItem() == item2 && line->endItem() == item1)) {
-            line->removeFromScene();
-            it = lines.erase(it);
+void CustomScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
+    static const int category = PerfStats::instance().category("CustomScene::mouseMoveEvent");
+    PerfTimer timer(category);
+
+    if (selectionTool.isActive()) {
+        selectionTool.update(event->scenePos());
+        return;
+    }
+
+    if (selectedItem && event->buttons() & Qt::LeftButton) {
+        const QList<QGraphicsItem*> selection = selectedItem->isSelected() ? selectedItems() : QList<QGraphicsItem*>();
+        if (selection.size() > 1) {
+            // Group drag: every selected figure follows the grabbed one.
+            QVector<int> ids;
+            ids.reserve(selection.size());
+            for (QGraphicsItem *item : selection) {
+                const int id = FigureItem::idOf(item);
+                if (id >= 0) {
+                    ids.append(id);
+                }
+            }
+            moveFigures(ids, event->scenePos() - selectedItem->pos());
         } else {
-            ++it;
+            selectedItem->setPos(event->scenePos());
+            grid.move(selectedItemId, selectedItem->sceneBoundingRect().center());
+            if (journal) {
+                journal->recordMove(selectedItemId, selectedItem->pos());
+            }
+
+            markStale(selectedItemId);
+            LazyGeometry::refreshVisible(this);
         }
+
+        emit itemMoved(selectedItemId, event->scenePos());
     }
 
+    QGraphicsScene::mouseMoveEvent(event);
+
+    QGraphicsItem* item = itemAt(event->scenePos(), QTransform());
+    if (item && item->isSelected()) {
+        item->setZValue(maxZValue + 1);
 
-    QSqlQuery query;
+        maxZValue = item->zValue();
+    }
+}
 
+void CustomScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event) {
+    if (selectionTool.isActive()) {
+        SelectionTool::Mode mode = selectionTool.mode();
+        QPolygonF area = selectionTool.finish();
+        selectIds(mode == SelectionTool::Rectangle ? grid.query(area.boundingRect()) : grid.query(area));
+        return;
+    }
 
-    QString relatedIds1;
-    query.prepare("SELECT related_ids FROM figures WHERE id = ?");
-    query.addBindValue(id1);
-    if (query.exec() && query.next()) {
-        relatedIds1 = query.value(0).toString();
+    QGraphicsScene::mouseReleaseEvent(event);
+}
+
+CustomLine *CustomScene::addLine(int id1, int id2) {
+    const quint64 key = ChangeJournal::State::linkKey(id1, id2);
+    if (id1 == id2 || linkKeys.contains(key)) {
+        return nullptr;
     }
-    QStringList updatedRelatedIds1 = relatedIds1.split(",", QString::SkipEmptyParts);
-    updatedRelatedIds1.removeAll(QString::number(id2));
+    FigureItem *item1 = itemById(id1);
+    FigureItem *item2 = itemById(id2);
+    if (!item1 || !item2) {
+        return nullptr;
+    }
+
+    CustomLine *line = new CustomLine(item1, item2, this);
+    line->setVisible(item1->isVisible() && item2->isVisible());
+    lines.append(line);
+    linkKeys.insert(key);
+    ++degrees[id1];
+    ++degrees[id2];
+    return line;
+}
 
-    query.prepare("UPDATE figures SET related_ids = ? WHERE id = ?");
-    query.addBindValue(updatedRelatedIds1.join(","));
-    query.addBindValue(id1);
-    if (!query.exec()) {
-        qWarning() << "Failed to update related IDs for figure" << id1 << ":" << query.lastError().text();
+CustomLine *CustomScene::connectFigures(int id1, int id2) {
+    CustomLine *line = addLine(id1, id2);
+    if (!line) {
+        return nullptr;
     }
 
+    invalidateGraph();
+    if (journal) {
+        journal->recordLink(id1, id2);
+    }
+    return line;
+}
 
-    QString relatedIds2;
-    query.prepare("SELECT related_ids FROM figures WHERE id = ?");
-    query.addBindValue(id2);
-    if (query.exec() && query.next()) {
-        relatedIds2 = query.value(0).toString();
+QVector<QPair<int, int>> CustomScene::connectFigures(const QVector<QPair<int, int>> &pairs) {
+    static const int category = PerfStats::instance().category("CustomScene::connectFigures");
+    PerfTimer timer(category);
+
+    QVector<QPair<int, int>> added;
+    added.reserve(pairs.size());
+    lines.reserve(lines.size() + pairs.size());
+    linkKeys.reserve(linkKeys.size() + pairs.size());
+    for (const QPair<int, int> &pair : pairs) {
+        if (addLine(pair.first, pair.second)) {
+            added.append(qMakePair(qMin(pair.first, pair.second), qMax(pair.first, pair.second)));
+        }
     }
-    QStringList updatedRelatedIds2 = relatedIds2.split(",", QString::SkipEmptyParts);
-    updatedRelatedIds2.removeAll(QString::number(id1));
 
-    query.prepare("UPDATE figures SET related_ids = ? WHERE id = ?");
-    query.addBindValue(updatedRelatedIds2.join(","));
-    query.addBindValue(id2);
-    if (!query.exec()) {
-        qWarning() << "Failed to update related IDs for figure" << id2 << ":" << query.lastError().text();
+    if (!added.isEmpty()) {
+        invalidateGraph();
+        if (journal) {
+            journal->recordLinks(added);
+        }
     }
+    return added;
+}
 
-    qDebug() << "Pair deleted between figures" << id1 << "and" << id2 << "and updated in the database.";
+bool CustomScene::disconnectFigures(int id1, int id2) {
+    return !disconnectFigures(QVector<QPair<int, int>>{ qMakePair(id1, id2) }).isEmpty();
 }
 
-void CustomScene::deleteRelatedLines(int id) {
-    auto it = lines.begin();
-    while (it != lines.end()) {
-        CustomLine *line = *it;
-        if (line->startItem()->data(0).toInt() == id || line->endItem()->data(0).toInt() == id) {
-            line->removeFromScene();
-            it = lines.erase(it);
+QVector<QPair<int, int>> CustomScene::disconnectFigures(const QVector<QPair<int, int>> &pairs) {
+    QSet<quint64> doomed;
+    doomed.reserve(pairs.size());
+    for (const QPair<int, int> &pair : pairs) {
+        const quint64 key = ChangeJournal::State::linkKey(pair.first, pair.second);
+        if (linkKeys.contains(key)) {
+            doomed.insert(key);
+        }
+    }
+
+    QVector<QPair<int, int>> removed;
+    if (doomed.isEmpty()) {
+        return removed;
+    }
+
+    // One pass over the lines however many pairs go.
+    removed.reserve(doomed.size());
+    QList<CustomLine*> kept;
+    kept.reserve(lines.size());
+    for (CustomLine *line : lines) {
+        const quint64 key = ChangeJournal::State::linkKey(line->startItem()->id(), line->endItem()->id());
+        if (doomed.contains(key)) {
+            removed.append(ChangeJournal::State::linkIds(key));
+            lineRemoved(line);
+            delete line;
         } else {
-            ++it;
+            kept.append(line);
         }
     }
-}
+    lines.swap(kept);
 
-void CustomScene::hideConnections(int itemId) {
-    QGraphicsItem *selectedItem = nullptr;
+    invalidateGraph();
+    if (journal) {
+        journal->recordUnlinks(removed);
+    }
+    return removed;
+}
 
+void CustomScene::removeFigures(const QVector<int> &ids) {
+    QSet<int> doomed;
+    doomed.reserve(ids.size());
+    for (int id : ids) {
+        doomed.insert(id);
+    }
 
-    for (QGraphicsItem *item : items()) {
-        if (item->data(0).toInt() == itemId) {
-            selectedItem = item;
-            break;
+    // One pass over the lines, then one over the figures; nothing is
+    // re-scanned per deleted id.
+    QList<CustomLine*> kept;
+    kept.reserve(lines.size());
+    for (CustomLine *line : lines) {
+        if (doomed.contains(line->startItem()->id()) || doomed.contains(line->endItem()->id())) {
+            lineRemoved(line);
+            delete line;
+        } else {
+            kept.append(line);
         }
     }
+    lines.swap(kept);
 
-    if (!selectedItem) {
-        qWarning() << "Item with ID" << itemId << "not found.";
-        return;
+    if (doomed.contains(selectedItemId)) {
+        selectedItem = nullptr;
+        selectedItemId = -1;
     }
 
+    QVector<int> removed;
+    removed.reserve(doomed.size());
+    for (int id : doomed) {
+        if (FigureItem *item = itemById(id)) {
+            unregisterItem(id);
+            removeItem(item);
+            delete item;
+            removed.append(id);
+        }
+    }
+    invalidateGraph();
+    if (journal) {
+        journal->recordDelete(removed);
+    }
 
-    selectedItem->setVisible(false);
+    if (nodes.size() == 0) {
+        FigureItem::trimPool();
+        CustomLine::trimPool();
+    }
+}
 
+void CustomScene::hideConnections(int itemId) {
+    queryConnections(itemId, ConnectionQuery::Neighbors);
+}
 
+QVector<QPair<int, int>> CustomScene::edgeList() const {
+    QVector<QPair<int, int>> edges;
+    edges.reserve(lines.size());
     for (CustomLine *line : lines) {
-        if (line->startItem() == selectedItem || line->endItem() == selectedItem) {
-            line->setVisible(false);
+        edges.append(qMakePair(line->startItem()->id(), line->endItem()->id()));
+    }
+    return edges;
+}
 
+void CustomScene::invalidateGraph() {
+    graph.reset();
+    ++graphGeneration;
+    incidentDirty = true;
+}
 
-            if (line->startItem() != selectedItem) {
-                line->startItem()->setVisible(false);
-            }
-            if (line->endItem() != selectedItem) {
-                line->endItem()->setVisible(false);
-            }
-        }
+void CustomScene::queryConnections(int id, ConnectionQuery query, int hops) {
+    if (!nodes.contains(id)) {
+        qWarning() << "Item with ID" << id << "not found.";
+        return;
     }
 
-    qDebug() << "Connections hidden for item with ID:" << itemId;
+    // The CSR snapshot is built and queried on the thread pool; the GUI
+    // thread only copies the edge list when the cached snapshot is stale.
+    std::shared_ptr<ConnectionGraph> snapshot = graph;
+    QVector<QPair<int, int>> edges;
+    if (!snapshot) {
+        edges = edgeList();
+    }
+    const int generation = graphGeneration;
+
+    auto *watcher = new QFutureWatcher<ConnectionQueryResult>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, id, query, generation]() {
+        ConnectionQueryResult result = watcher->result();
+        watcher->deleteLater();
+
+        if (generation == graphGeneration) {
+            graph = result.graph;
+        }
+        emit connectionsFound(id, query, result.ids);
+    });
+
+    watcher->setFuture(QtConcurrent::run([snapshot, edges, id, query, hops]() {
+        ConnectionQueryResult result;
+        result.graph = snapshot ? snapshot : std::make_shared<ConnectionGraph>(ConnectionGraph::build(edges));
+
+        switch (query) {
+        case ConnectionQuery::Neighbors:
+            result.ids = result.graph->neighbors(id);
+            break;
+        // In an undirected graph the component of id is what it reaches.
+        case ConnectionQuery::Reachable:
+        case ConnectionQuery::Component:
+            result.ids = result.graph->reachable(id);
+            break;
+        case ConnectionQuery::Neighborhood:
+            result.ids = result.graph->neighborhood(id, hops);
+            break;
+        }
+        return result;
+    }));
 }
@@ -5,12 +5,27 @@
 #include <QGraphicsLineItem>
 #include <QGraphicsSceneMouseEvent>
 #include <QList>
+#include <QHash>
+#include <QSet>
+#include <QTransform>
 #include <QGraphicsItem>
+#include <memory>
+#include "objectpool.h"
+#include "connectiongraph.h"
+#include "spatialgrid.h"
+#include "selectiontool.h"
+#include "figurefilter.h"
+#include "figureitem.h"
+#include "nodestore.h"
+#include "edgekernel.h"
+#include "nodelayout.h"
+#include "changejournal.h"
+#include "lazygeometry.h"
 
-class CustomLine : public QGraphicsLineItem {
+class CustomLine : public QGraphicsLineItem, public PooledItem<CustomLine> {
 public:
-    CustomLine(QGraphicsItem *startItem, QGraphicsItem *endItem, QGraphicsScene *scene)
-        : QGraphicsLineItem(nullptr), m_startItem(startItem), m_endItem(endItem), m_scene(scene) {
+    CustomLine(FigureItem *startItem, FigureItem *endItem, QGraphicsScene *scene)
+        : QGraphicsLineItem(nullptr), m_startItem(startItem), m_endItem(endItem) {
         updateLine();
         scene->addItem(this);
     }
@@ -23,39 +38,90 @@ public:
         }
     }
 
-    QGraphicsItem* startItem() const { return m_startItem; }
-    QGraphicsItem* endItem() const { return m_endItem; }
-
-    void removeFromScene() {
-        if (m_scene) {
-            m_scene->removeItem(this);
-            delete this;
-        }
-    }
+    FigureItem* startItem() const { return m_startItem; }
+    FigureItem* endItem() const { return m_endItem; }
 
 private:
-    QGraphicsItem *m_startItem;
-    QGraphicsItem *m_endItem;
-    QGraphicsScene *m_scene;
+    friend class CustomScene;
+    template <typename> friend class StaleLines;
+
+    FigureItem *m_startItem;
+    FigureItem *m_endItem;
+    int staleIndex = -1;
 };
 
-class CustomScene : public QGraphicsScene {
+enum class ConnectionQuery {
+    Neighbors,
+    Reachable,
+    Component,
+    Neighborhood
+};
+
+// Lines attached to a moved figure are only marked stale; their geometry
+// is recomputed for the part of the scene that is on screen or about to be
+// drawn, and for hidden lines not at all until they are shown.
+class CustomScene : public QGraphicsScene, public LazyGeometry {
     Q_OBJECT
 
 public:
     explicit CustomScene(QObject *parent = nullptr);
 
+    // Mutations made while a journal is set are recorded to it.
+    void setJournal(ChangeJournal *journal) { this->journal = journal; }
+
+    FigureItem *addFigure(int id, FigureKind kind, const QSizeF &size, int sides = 0);
+    void unregisterItem(int id);
+    FigureItem *itemById(int id) const;
+    ChangeJournal::State snapshot() const;
+    CustomLine *connectFigures(int id1, int id2);
+    bool disconnectFigures(int id1, int id2);
+
+    // Batch forms. Self-links, links that already exist, repeats within
+    // the batch and unknown ids are skipped; the pairs actually applied
+    // are returned with the smaller id first.
+    QVector<QPair<int, int>> connectFigures(const QVector<QPair<int, int>> &pairs);
+    QVector<QPair<int, int>> disconnectFigures(const QVector<QPair<int, int>> &pairs);
+    int figureCount() const { return nodes.size(); }
+    int lineCount() const { return lines.size(); }
+
+    QVector<int> figureIds() const { return nodes.ids(); }
+    const NodeStore &nodeStore() const { return nodes; }
+
+    void moveFigures(const QVector<int> &ids, const QPointF &delta);
+    void transformFigures(const QVector<int> &ids, const QTransform &transform);
+    // record is false for the frames a running layout streams; the layout
+    // records its result once it finishes.
+    void setFigurePositions(const QVector<int> &ids, const QVector<QPointF> &positions, bool record = true);
+
+    bool startLayout(bool newOnly);
+    void cancelLayout();
+    bool isLayoutRunning() const { return layout.isRunning(); }
+
+    void applyFilter(const FigureFilter &filter);
+    void setHidden(const QVector<int> &ids, bool hidden);
+    bool isHidden(int id) const;
+    // Shows only ids, or hides ids, until showAll(), on top of the filter
+    // and the hidden flags. Only the view changes; nothing is journaled or
+    // stored.
+    void showOnly(const QVector<int> &ids);
+    void hideInView(const QVector<int> &ids);
+    void showAll();
+    bool isShowingOnly() const { return showingOnly; }
+
+    void refreshGeometry(const QRectF &sceneRect) override;
+
 signals:
     void itemSelected(int id);
     void itemMoved(int id, const QPointF &newPos);
+    void connectionsFound(int id, ConnectionQuery query, const QVector<int> &ids);
+    void layoutFinished(int iterations, bool canceled);
 
 public slots:
-    void createPair(int id1, int id2);
-    void deletePair(int id1, int id2);
-    void deleteRelatedLines(int id);
+    void removeFigures(const QVector<int> &ids);
 
 
     void hideConnections(int id);
+    void queryConnections(int id, ConnectionQuery query, int hops = 1);
     QGraphicsItem* getSelectedItem() const {
         return selectedItem;
     }
@@ -63,11 +129,41 @@ public slots:
 protected:
     void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
 private:
+    void selectIds(const QVector<int> &ids);
+    QVector<QPair<int, int>> edgeList() const;
+    void invalidateGraph();
+    CustomLine *addLine(int id1, int id2);
+    void lineRemoved(CustomLine *line);
+    void markStale(int id);
+    void onLayoutFinished(int iterations, bool canceled);
+    void ensureIncidentIndex();
+    bool figureVisible(int slot) const;
+    void updateLineVisibility();
+
     QGraphicsItem *selectedItem = nullptr;
     int selectedItemId = -1;
     QList<CustomLine*> lines;
+    QSet<quint64> linkKeys;
+    NodeStore nodes;
+    QVector<FigureItem*> views;
+    QHash<int, int> degrees;
+    FigureFilter filter;
+    QSet<int> shownOnly;
+    bool showingOnly = false;
+    QSet<int> hiddenInView;
+    EdgeKernel edgeKernel;
+    StaleLines<CustomLine> staleLines;
+    QHash<int, QVector<CustomLine*>> incidentLines;
+    bool incidentDirty = true;
+    NodeLayout layout;
+    ChangeJournal *journal = nullptr;
+    SpatialGrid grid;
+    SelectionTool selectionTool;
+    std::shared_ptr<ConnectionGraph> graph;
+    int graphGeneration = 0;
     qreal maxZValue;
 };
 
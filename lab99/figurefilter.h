@@ -0,0 +1,33 @@
+#ifndef FIGUREFILTER_H
+#define FIGUREFILTER_H
+
+#include "figurekind.h"
+
+struct FigureFilter {
+    enum Connectivity {
+        AnyConnectivity,
+        Connected,
+        Isolated
+    };
+
+    bool allTypes = true;
+    FigureKind kind = FigureKind::Unknown;
+    int minId = -1;
+    int maxId = -1;
+    Connectivity connectivity = AnyConnectivity;
+
+    bool isEmpty() const {
+        return allTypes && minId < 0 && maxId < 0 && connectivity == AnyConnectivity;
+    }
+
+    bool accepts(int id, FigureKind figureKind, bool connected) const {
+        if (!allTypes && figureKind != kind) return false;
+        if (minId >= 0 && id < minId) return false;
+        if (maxId >= 0 && id > maxId) return false;
+        if (connectivity == Connected && !connected) return false;
+        if (connectivity == Isolated && connected) return false;
+        return true;
+    }
+};
+
+#endif // FIGUREFILTER_H
@@ -0,0 +1,98 @@
+#include "figureitem.h"
+#include "geometrycache.h"
+#include <QPainter>
+#include <QStyle>
+#include <QStyleOptionGraphicsItem>
+
+FigureItem::FigureItem(int id, NodeStore *store)
+    : nodeId(id), store(store) {
+    setFlags(ItemIsSelectable | ItemSendsGeometryChanges);
+}
+
+int FigureItem::idOf(const QGraphicsItem *item) {
+    const FigureItem *figure = qgraphicsitem_cast<const FigureItem *>(item);
+    return figure ? figure->id() : -1;
+}
+
+FigureKind FigureItem::kind() const {
+    const int slot = store->slotOf(nodeId);
+    return slot < 0 ? FigureKind::Unknown : store->kindAt(slot);
+}
+
+QRectF FigureItem::localRect() const {
+    const int slot = store->slotOf(nodeId);
+    if (slot < 0) {
+        return QRectF();
+    }
+
+    const QSizeF size = store->sizeAt(slot);
+    switch (store->kindAt(slot)) {
+    case FigureKind::Rectangle:
+        return QRectF(-size.width(), -size.height(), size.width(), size.height());
+    case FigureKind::Ellipse:
+    case FigureKind::Polygon:
+        return QRectF(-size.width() / 2, -size.height() / 2, size.width(), size.height());
+    default:
+        return QRectF();
+    }
+}
+
+QPainterPath FigureItem::outline(qreal levelOfDetail) const {
+    const int slot = store->slotOf(nodeId);
+    if (slot < 0) {
+        return QPainterPath();
+    }
+
+    GeometryCache &cache = GeometryCache::instance();
+    switch (store->kindAt(slot)) {
+    case FigureKind::Rectangle:
+        return cache.rectPath(localRect());
+    case FigureKind::Ellipse:
+        return cache.ellipsePath(localRect());
+    case FigureKind::Polygon:
+        return cache.polygonPath(store->sidesAt(slot), store->sizeAt(slot).width() / 2, levelOfDetail);
+    default:
+        return QPainterPath();
+    }
+}
+
+QRectF FigureItem::boundingRect() const {
+    // Half the pen width on every side.
+    return localRect().adjusted(-0.5, -0.5, 0.5, 0.5);
+}
+
+QPainterPath FigureItem::shape() const {
+    return outline();
+}
+
+void FigureItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    Q_UNUSED(widget)
+
+    QBrush brush;
+    switch (kind()) {
+    case FigureKind::Rectangle: brush = Qt::red; break;
+    case FigureKind::Ellipse: brush = Qt::green; break;
+    case FigureKind::Polygon: brush = Qt::blue; break;
+    default: break;
+    }
+
+    painter->setPen(QPen(Qt::black));
+    painter->setBrush(brush);
+    painter->drawPath(outline(option->levelOfDetailFromTransform(painter->worldTransform())));
+
+    if (option->state & QStyle::State_Selected) {
+        painter->setPen(QPen(Qt::black, 0, Qt::DashLine));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawRect(localRect());
+    }
+}
+
+QVariant FigureItem::itemChange(GraphicsItemChange change, const QVariant &value) {
+    if (change == ItemPositionHasChanged) {
+        const int slot = store->slotOf(nodeId);
+        if (slot >= 0) {
+            store->setPosition(slot, value.toPointF());
+        }
+    }
+    return QGraphicsItem::itemChange(change, value);
+}
@@ -0,0 +1,41 @@
+#ifndef FIGUREITEM_H
+#define FIGUREITEM_H
+
+#include <QGraphicsItem>
+#include "nodestore.h"
+#include "objectpool.h"
+
+// Scene view of one figure. The item keeps only its id and a pointer to
+// the node store; kind, size and the last known position live in the
+// store, and pen, brush and outline are derived from the kind. Items are
+// carved from a slab pool; see ObjectPool.
+class FigureItem : public QGraphicsItem, public PooledItem<FigureItem> {
+public:
+    enum { Type = UserType + 1 };
+
+    FigureItem(int id, NodeStore *store);
+
+    int id() const { return nodeId; }
+    FigureKind kind() const;
+
+    int type() const override { return Type; }
+    QRectF boundingRect() const override;
+    QPainterPath shape() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+    static int idOf(const QGraphicsItem *item);
+
+protected:
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+
+private:
+    QRectF localRect() const;
+    // levelOfDetail is in device pixels per item unit; 1 is the outline
+    // used for hit testing.
+    QPainterPath outline(qreal levelOfDetail = 1) const;
+
+    int nodeId;
+    NodeStore *store;
+};
+
+#endif // FIGUREITEM_H
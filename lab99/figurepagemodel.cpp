@@ -0,0 +1,258 @@
+#include "figurepagemodel.h"
+#include "sqlexecutor.h"
+#include <QSqlQuery>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+const char *const columnNames[] = { "id", "type", "related_ids", "type_count", "hidden" };
+const int ColumnCount = 5;
+
+}
+
+FigurePageModel::FigurePageModel(QObject *parent)
+    : QAbstractTableModel(parent), pages(MaxCachedPages)
+{
+    reload();
+}
+
+int FigurePageModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : count;
+}
+
+int FigurePageModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant FigurePageModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role == Qt::DisplayRole && orientation == Qt::Horizontal && section >= 0 && section < ColumnCount) {
+        return QString::fromLatin1(columnNames[section]);
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+QVariant FigurePageModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole && role != IconRole)) {
+        return QVariant();
+    }
+
+    const Page *cached = page(index.row() / PageSize);
+    const int offset = index.row() % PageSize;
+    if (!cached || offset >= cached->rows.size()) {
+        return QVariant();
+    }
+
+    const Row &row = cached->rows.at(offset);
+    if (role == IconRole) {
+        return QVariant::fromValue(row.icon);
+    }
+    switch (index.column()) {
+    case 0: return row.id;
+    case 1: return row.type;
+    case 2: return row.relatedIds;
+    case 3: return row.typeCount;
+    case 4: return row.hidden ? 1 : 0;
+    default: return QVariant();
+    }
+}
+
+void FigurePageModel::setFigureFilter(const FigureFilter &newFilter)
+{
+    filter = newFilter;
+    filterConditions.clear();
+    filterValues.clear();
+
+    // type and id are indexed, so a selective filter seeks rather than scans.
+    if (!filter.allTypes) {
+        filterConditions << "type = ?";
+        filterValues << figureKindName(filter.kind);
+    }
+    if (filter.minId >= 0) {
+        filterConditions << "id >= ?";
+        filterValues << filter.minId;
+    }
+    if (filter.maxId >= 0) {
+        filterConditions << "id <= ?";
+        filterValues << filter.maxId;
+    }
+    if (filter.connectivity == FigureFilter::Connected) {
+        filterConditions << "related_ids <> ''";
+    } else if (filter.connectivity == FigureFilter::Isolated) {
+        filterConditions << "COALESCE(related_ids, '') = ''";
+    }
+
+    reload();
+}
+
+void FigurePageModel::reload()
+{
+    beginResetModel();
+    dirty = false;
+    pages.clear();
+    pageStarts.clear();
+    count = 0;
+    lastId = -1;
+
+    // Only the primary key is read, and only every PageSize-th id is kept.
+    QSqlQuery query;
+    prepare(query, "id", QString(), "ORDER BY id");
+    query.setForwardOnly(true);
+    if (SqlExecutor::exec(query, "FigurePageModel::reload")) {
+        while (query.next()) {
+            lastId = query.value(0).toInt();
+            if (count % PageSize == 0) {
+                pageStarts.append(lastId);
+            }
+            ++count;
+        }
+    }
+    endResetModel();
+}
+
+void FigurePageModel::figureAdded(int id, FigureKind kind)
+{
+    if (dirty) {
+        return;
+    }
+    if (!filter.accepts(id, kind, false)) {
+        // Adding a figure still changes type_count of its kind.
+        refreshColumn(3);
+        return;
+    }
+    if (id <= lastId) {
+        invalidate();
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), count, count);
+    if (count % PageSize == 0) {
+        pageStarts.append(id);
+    }
+    ++count;
+    lastId = id;
+    endInsertRows();
+    refreshColumn(3);
+}
+
+void FigurePageModel::linksChanged()
+{
+    // Links move figures in and out of a connectivity filter; otherwise
+    // only related_ids changes.
+    if (filter.connectivity != FigureFilter::AnyConnectivity) {
+        invalidate();
+    } else if (!dirty) {
+        refreshColumn(2);
+    }
+}
+
+void FigurePageModel::invalidate()
+{
+    if (dirty) {
+        return;
+    }
+    dirty = true;
+    QTimer::singleShot(0, this, [this]() {
+        if (dirty) {
+            reload();
+        }
+    });
+}
+
+void FigurePageModel::refreshColumn(int column)
+{
+    pages.clear();
+    if (count > 0) {
+        emit dataChanged(index(0, column), index(count - 1, column));
+    }
+}
+
+int FigurePageModel::rowForId(int id)
+{
+    if (dirty) {
+        reload();
+    }
+
+    // The page that can hold id is the last one starting at or before it.
+    const auto start = std::upper_bound(pageStarts.constBegin(), pageStarts.constEnd(), id);
+    if (start == pageStarts.constBegin()) {
+        return -1;
+    }
+    const int pageNumber = int(start - pageStarts.constBegin()) - 1;
+    const Page *cached = page(pageNumber);
+    if (!cached) {
+        return -1;
+    }
+
+    const auto row = std::lower_bound(cached->rows.constBegin(), cached->rows.constEnd(), id,
+                                      [](const Row &row, int id) { return row.id < id; });
+    if (row == cached->rows.constEnd() || row->id != id) {
+        return -1;
+    }
+    return pageNumber * PageSize + int(row - cached->rows.constBegin());
+}
+
+const FigurePageModel::Page *FigurePageModel::page(int pageNumber) const
+{
+    if (Page *cached = pages.object(pageNumber)) {
+        return cached;
+    }
+
+    Page *fetched = new Page;
+    if (!fetchPage(pageNumber, fetched)) {
+        delete fetched;
+        return nullptr;
+    }
+    pages.insert(pageNumber, fetched);
+    return fetched;
+}
+
+void FigurePageModel::prepare(QSqlQuery &query, const QString &columns, const QString &bound,
+                              const QString &tail) const
+{
+    QStringList conditions = filterConditions;
+    if (!bound.isEmpty()) {
+        conditions << bound;
+    }
+    QString sql = "SELECT " + columns + " FROM figures";
+    if (!conditions.isEmpty()) {
+        sql += " WHERE " + conditions.join(" AND ");
+    }
+    query.prepare(sql + " " + tail);
+
+    // The filter's values come first; the caller binds bound's after them.
+    for (const QVariant &value : filterValues) {
+        query.addBindValue(value);
+    }
+}
+
+bool FigurePageModel::fetchPage(int pageNumber, Page *page) const
+{
+    if (pageNumber < 0 || pageNumber >= pageStarts.size()) {
+        return false;
+    }
+
+    QSqlQuery query;
+    prepare(query, "id, type, related_ids, type_count, hidden", "id >= ?", "ORDER BY id LIMIT ?");
+    query.addBindValue(pageStarts.at(pageNumber));
+    query.addBindValue(int(PageSize));
+    query.setForwardOnly(true);
+
+    if (!SqlExecutor::exec(query, "FigurePageModel::fetchPage")) {
+        return false;
+    }
+
+    page->rows.reserve(PageSize);
+    while (query.next()) {
+        Row row = { query.value(0).toInt(), query.value(1).toString(), query.value(2).toString(),
+                    query.value(3).toInt(), query.value(4).toBool(), FigureIcon() };
+        row.icon.kind = figureKindFromName(row.type);
+        row.icon.tier = FigureIcon::tierForCount(row.typeCount);
+        page->rows.append(row);
+    }
+    return !page->rows.isEmpty();
+}
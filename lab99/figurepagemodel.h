@@ -0,0 +1,97 @@
+#ifndef FIGUREPAGEMODEL_H
+#define FIGUREPAGEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QVector>
+
+class QSqlQuery;
+#include "figurefilter.h"
+
+// What the type_count column draws: the figure's kind and how many icons
+// (1 to 3) its count earns. Worked out once per row when the page is
+// fetched, so painting a cell does no string work.
+struct FigureIcon {
+    FigureKind kind;
+    quint8 tier;
+
+    static quint8 tierForCount(int count) { return count > 10 ? 3 : count >= 4 ? 2 : 1; }
+};
+Q_DECLARE_METATYPE(FigureIcon)
+
+// Read-only view of the figures table, or of the figures a FigureFilter
+// accepts, that never holds more than a fixed number of pages. The filter
+// is part of every query, and each page is fetched on demand by seeking to
+// its first id on the primary key, then kept in an LRU cache. reload()
+// walks the matching ids once to note where each page starts, so memory
+// grows by one id per page, and the view can jump to any id without
+// counting rows.
+class FigurePageModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum {
+        PageSize = 256,
+        MaxCachedPages = 32
+    };
+
+    enum Roles {
+        IconRole = Qt::UserRole + 1
+    };
+
+    explicit FigurePageModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setFigureFilter(const FigureFilter &filter);
+    const FigureFilter &figureFilter() const { return filter; }
+
+    void reload();
+    void refreshColumn(int column);
+    int rowForId(int id);
+
+    // Cheap updates after single edits. A figure added with a larger id
+    // than any shown is appended in place; anything else, and every
+    // removal, marks the model dirty and it is reloaded once when control
+    // returns to the event loop (or at the next rowForId).
+    void figureAdded(int id, FigureKind kind);
+    void linksChanged();
+    void invalidate();
+
+private:
+    struct Row {
+        int id;
+        QString type;
+        QString relatedIds;
+        int typeCount;
+        bool hidden;
+        FigureIcon icon;
+    };
+
+    struct Page {
+        QVector<Row> rows;
+    };
+
+    const Page *page(int pageNumber) const;
+    bool fetchPage(int pageNumber, Page *page) const;
+
+    void prepare(QSqlQuery &query, const QString &columns, const QString &bound, const QString &tail) const;
+
+    FigureFilter filter;
+    // The filter as SQL conditions on the figures table, and their values.
+    QStringList filterConditions;
+    QVariantList filterValues;
+    int count = 0;
+    int lastId = -1;
+    QVector<int> pageStarts;
+    bool dirty = false;
+    mutable QCache<int, Page> pages;
+};
+
+#endif // FIGUREPAGEMODEL_H
@@ -3,71 +3,78 @@
 
 #include <QStyledItemDelegate>
 #include <QPainter>
+#include "figurepagemodel.h"
 
+// Draws the type_count column as one to three icons of the figure's kind.
+// Everything it needs comes from FigurePageModel::IconRole.
 class IconDelegate : public QStyledItemDelegate {
 public:
     explicit IconDelegate(QObject *parent = nullptr) : QStyledItemDelegate(parent) {}
 
     void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override {
+        const QVariant data = index.data(FigurePageModel::IconRole);
+        if (!data.isValid()) {
+            QStyledItemDelegate::paint(painter, option, index);
+            return;
+        }
 
-        if (index.column() == 3) {
-
-            int count = index.data(Qt::DisplayRole).toInt();
-
-
-            QModelIndex typeIndex = index.model()->index(index.row(), 1);
-            QString shapeType = typeIndex.data(Qt::DisplayRole).toString();
-
-            painter->save();
-
+        const FigureIcon icon = data.value<FigureIcon>();
+        if (icon.kind == FigureKind::Unknown) {
+            return;
+        }
 
-            int iconCount = 1;
-            if (count >= 4 && count <= 10) {
-                iconCount = 2;
-            } else if (count > 10) {
-                iconCount = 3;
+        const int iconSize = iconSizeFor(option.rect.height());
+        int x = option.rect.x() + Spacing;
+        const int y = option.rect.y() + (option.rect.height() - iconSize) / 2;
+
+        painter->save();
+        painter->setBrush(brushFor(icon.kind));
+        for (int i = 0; i < icon.tier; ++i) {
+            const QRect iconRect(x, y, iconSize, iconSize);
+            switch (icon.kind) {
+            case FigureKind::Rectangle:
+                painter->drawRect(iconRect);
+                break;
+            case FigureKind::Ellipse:
+                painter->drawEllipse(iconRect);
+                break;
+            default: {
+                const QPointF triangle[3] = {
+                    QPointF(x + iconSize / 2, y),
+                    QPointF(x, y + iconSize),
+                    QPointF(x + iconSize, y + iconSize)
+                };
+                painter->drawPolygon(triangle, 3);
+                break;
             }
+            }
+            x += iconSize + Spacing;
+        }
+        painter->restore();
+    }
 
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override {
+        const QVariant data = index.data(FigurePageModel::IconRole);
+        const QSize base = QStyledItemDelegate::sizeHint(option, index);
+        if (!data.isValid()) {
+            return base;
+        }
 
-            int iconSize = option.rect.height() * 0.7;
-            int spacing = 5;
-
-
-            int x = option.rect.x() + spacing;
-            int y = option.rect.y() + (option.rect.height() - iconSize) / 2;
-
-
-            for (int i = 0; i < iconCount; ++i) {
-                QRect iconRect(x, y, iconSize, iconSize);
-
-
-                if (shapeType == "rectangle") {
-                    painter->setBrush(Qt::red);
-                    painter->drawRect(iconRect);
-                } else if (shapeType == "ellipse") {
-                    painter->setBrush(Qt::green);
-                    painter->drawEllipse(iconRect);
-                } else if (shapeType == "polygon") {
-                    painter->setBrush(Qt::blue);
-
-                    QPointF point1(x + iconSize / 2, y);
-                    QPointF point2(x, y + iconSize);
-                    QPointF point3(x + iconSize, y + iconSize);
-
-                    QPolygonF triangle;
-                    triangle << point1 << point2 << point3;
-
-                    painter->drawPolygon(triangle);
-                }
-
+        const int tier = data.value<FigureIcon>().tier;
+        const int width = Spacing + tier * (iconSizeFor(base.height()) + Spacing);
+        return QSize(width, base.height());
+    }
 
-                x += iconSize + spacing;
-            }
+private:
+    enum { Spacing = 5 };
 
-            painter->restore();
-        } else {
+    static int iconSizeFor(int height) { return height * 0.7; }
 
-            QStyledItemDelegate::paint(painter, option, index);
+    static Qt::GlobalColor brushFor(FigureKind kind) {
+        switch (kind) {
+        case FigureKind::Rectangle: return Qt::red;
+        case FigureKind::Ellipse: return Qt::green;
+        default: return Qt::blue;
         }
     }
 };
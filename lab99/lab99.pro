@@ -28,16 +28,26 @@ CONFIG += c++11
 SOURCES += \
         main.cpp \
         mainwindow.cpp \
-    customscene.cpp
+    customscene.cpp \
+    sqlprofilerdialog.cpp \
+    figurepagemodel.cpp \
+    figureitem.cpp
 
 HEADERS += \
         mainwindow.h \
     customscene.h \
-    icondelegate.h
+    icondelegate.h \
+    sqlprofilerdialog.h \
+    figurefilter.h \
+    figurepagemodel.h \
+    figureitem.h
 
 FORMS += \
         mainwindow.ui
 
+include(../core/core.pri)
+include(../common/common.pri)
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -3,7 +3,25 @@
 
 int main(int argc, char *argv[])
 {
+    // --batch SCRIPT runs the script without a display and exits; the
+    // offscreen platform still gives the scene fonts and image export.
+    QString script;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (qstrcmp(argv[i], "--batch") == 0) {
+            script = QString::fromLocal8Bit(argv[i + 1]);
+        }
+    }
+    if (!script.isEmpty() && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication a(argc, argv);
+
+    if (!script.isEmpty()) {
+        MainWindow w(nullptr, true);
+        return w.runScript(script) ? 0 : 1;
+    }
+
     MainWindow w;
     w.show();
 
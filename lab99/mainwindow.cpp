@@ -1,8 +1,14 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "icondelegate.h"
-#include <QSqlTableModel>
-#include <QSqlQuery>
+#include "sceneexporter.h"
+#include "geometrycache.h"
+#include "perfstats.h"
+#include "sqlprofilerdialog.h"
+#include "scriptrunner.h"
+#include "minimapwidget.h"
+#include "tracereplayer.h"
+#include "scenecommands.h"
 #include <QSqlError>
 #include <QMessageBox>
 #include <QGraphicsItem>
@@ -11,10 +17,35 @@
 #include <QFile>
 #include <QComboBox>
 #include <QInputDialog>
+#include <QFileDialog>
+#include <QAction>
+#include <QSet>
+#include <QItemSelectionModel>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QDockWidget>
 
-MainWindow::MainWindow(QWidget *parent) :
+namespace {
+
+QString joinIds(const QVector<int> &ids)
+{
+    QStringList parts;
+    parts.reserve(ids.size());
+    for (int id : ids) {
+        parts << QString::number(id);
+    }
+    return parts.join(' ');
+}
+
+// Batch script names of FigureFilter::Connectivity, in enum order.
+const QStringList connectivityNames = { "any", "connected", "isolated" };
+
+}
+
+MainWindow::MainWindow(QWidget *parent, bool batchMode) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    batchMode(batchMode)
 {
     ui->setupUi(this);
 
@@ -22,14 +53,24 @@ MainWindow::MainWindow(QWidget *parent) :
     initializeDatabase();
 
 
-    model = new QSqlTableModel(this);
-    model->setTable("figures");
-    model->select();
+    model = new FigurePageModel(this);
     ui->tableView->setModel(model);
 
 
     scene = new CustomScene(this);
     ui->graphicsView->setScene(scene);
+    ui->graphicsView->setCountsProvider([this]() {
+        return qMakePair(scene->figureCount(), scene->lineCount());
+    });
+    recorder = new TraceRecorder(ui->graphicsView, [this]() { return scene->snapshot(); }, this);
+
+    // Batch runs start empty and leave no autosave behind unless a script
+    // asks for one. Ids are allocated only after recovery, so they continue
+    // past the recovered figures.
+    if (!batchMode) {
+        startAutosave("figures.autosave");
+    }
+    idAllocator = new IdAllocator("figures", "figures");
 
 
     setupConnections();
@@ -40,6 +81,9 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    scene->setJournal(nullptr);
+    delete journal;
+    delete idAllocator;
     delete ui;
 }
 
@@ -56,22 +100,21 @@ void MainWindow::initializeDatabase()
     db.setDatabaseName("figures.db");
 
     if (!db.open()) {
-        QMessageBox::critical(this, "Error", "Failed to open the database: " + db.lastError().text());
+        reportError("Failed to open the database: " + db.lastError().text());
         return;
     }
 
 
-    QSqlQuery query;
-    query.exec("CREATE TABLE IF NOT EXISTS figures ("
-               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "type TEXT, "
-               "related_ids TEXT, type_count INTEGER)");
+    if (!store.createSchema()) {
+        reportError("Failed to create the figures table: " + store.lastError());
+    }
 }
 
 void MainWindow::updateDelegate()
 {
-
-    ui->tableView->setItemDelegateForColumn(3, new IconDelegate(this));
+    if (!ui->tableView->itemDelegateForColumn(3)) {
+        ui->tableView->setItemDelegateForColumn(3, new IconDelegate(this));
+    }
 }
 
 void MainWindow::setupConnections() {
@@ -81,8 +124,73 @@ void MainWindow::setupConnections() {
     connect(ui->deleteButton, &QPushButton::clicked, this, &MainWindow::deleteSelectedItem);
     connect(scene, &CustomScene::itemSelected, this, &MainWindow::onSceneItemSelected);
     connect(ui->filterButton, &QPushButton::clicked, this, &MainWindow::onFilterButtonClicked);
+    connect(ui->filterComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onFilterButtonClicked);
+    connect(ui->connectivityComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onFilterButtonClicked);
+    connect(ui->minIdEdit, &QLineEdit::textChanged, this, &MainWindow::onFilterButtonClicked);
+    connect(ui->maxIdEdit, &QLineEdit::textChanged, this, &MainWindow::onFilterButtonClicked);
     connect(ui->deletePairButton, &QPushButton::clicked, this, &MainWindow::deletePair);
     connect(ui->hideConnectionsButton, &QPushButton::clicked, this, &MainWindow::hideConnections);
+    connect(ui->hideSelectedButton, &QPushButton::clicked, this, &MainWindow::hideSelected);
+    connect(ui->showHiddenButton, &QPushButton::clicked, this, &MainWindow::showHidden);
+    connect(scene, &CustomScene::connectionsFound, this, &MainWindow::onConnectionsFound);
+    connect(ui->exportImageButton, &QPushButton::clicked, this, &MainWindow::exportImage);
+    connect(ui->exportTilesButton, &QPushButton::clicked, this, &MainWindow::exportTiles);
+
+    QAction *hudAction = ui->mainToolBar->addAction("HUD");
+    hudAction->setCheckable(true);
+    hudAction->setShortcut(Qt::Key_F3);
+    connect(hudAction, &QAction::toggled, ui->graphicsView, &PerfView::setHudVisible);
+
+    QAction *dumpAction = ui->mainToolBar->addAction("Dump Perf JSON");
+    dumpAction->setShortcut(QKeySequence("Ctrl+Shift+J"));
+    connect(dumpAction, &QAction::triggered, this, [this]() {
+        if (PerfStats::instance().writeJson("perf.json")) {
+            ui->statusBar->showMessage("Performance data written to perf.json");
+        } else {
+            QMessageBox::warning(this, "Error", "Failed to write perf.json");
+        }
+    });
+
+    QAction *layoutAction = ui->mainToolBar->addAction("Auto Layout");
+    layoutAction->setShortcut(QKeySequence("Ctrl+L"));
+    connect(layoutAction, &QAction::triggered, this, [this]() { startLayout(false); });
+
+    QAction *layoutNewAction = ui->mainToolBar->addAction("Layout New");
+    layoutNewAction->setShortcut(QKeySequence("Ctrl+Shift+L"));
+    connect(layoutNewAction, &QAction::triggered, this, [this]() { startLayout(true); });
+
+    QAction *stopLayoutAction = ui->mainToolBar->addAction("Stop Layout");
+    connect(stopLayoutAction, &QAction::triggered, scene, &CustomScene::cancelLayout);
+    connect(scene, &CustomScene::layoutFinished, this, [this](int iterations, bool canceled) {
+        ui->statusBar->showMessage(QString("Layout %1 after %2 iterations")
+                                   .arg(canceled ? "stopped" : "finished").arg(iterations));
+    });
+
+    QDockWidget *minimapDock = new QDockWidget("Minimap", this);
+    minimapDock->setObjectName("minimapDock");
+    minimapDock->setWidget(new MinimapWidget(ui->graphicsView, minimapDock));
+    addDockWidget(Qt::RightDockWidgetArea, minimapDock);
+    QAction *minimapAction = minimapDock->toggleViewAction();
+    minimapAction->setShortcut(QKeySequence("Ctrl+M"));
+    ui->mainToolBar->addAction(minimapAction);
+
+    QAction *importLinksAction = ui->mainToolBar->addAction("Import Links");
+    connect(importLinksAction, &QAction::triggered, this, &MainWindow::importLinks);
+
+    QAction *traceAction = ui->mainToolBar->addAction("Record Trace");
+    traceAction->setCheckable(true);
+    traceAction->setShortcut(QKeySequence("Ctrl+Shift+R"));
+    connect(traceAction, &QAction::toggled, recorder, &TraceRecorder::setRecording);
+    connect(recorder, &TraceRecorder::saved, this, [this](const QString &fileName, int events) {
+        ui->statusBar->showMessage(QString("%1 events written to %2").arg(events).arg(fileName));
+    });
+
+    QAction *sqlProfileAction = ui->mainToolBar->addAction("SQL Profile");
+    connect(sqlProfileAction, &QAction::triggered, this, [this]() {
+        SqlProfilerDialog *dialog = new SqlProfilerDialog(this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        dialog->show();
+    });
 
     connect(ui->createPairButton, &QPushButton::clicked, this, [this]() {
         bool ok1, ok2;
@@ -99,42 +207,11 @@ void MainWindow::setupConnections() {
             return;
         }
 
-
-
-        scene->createPair(id1, id2);
-        model->select();
-    });
-}
-
-int MainWindow::getNextAvailableId()
-{
-    QSqlQuery query("SELECT MAX(id) FROM figures");
-    if (query.exec()) {
-        if (query.next()) {
-            int maxId = query.value(0).toInt();
-            return maxId + 1;
+        if (linkFigures(id1, id2)) {
+            model->linksChanged();
+            recorder->recordAction(QString("link %1 %2").arg(id1).arg(id2));
         }
-    }
-    return 1;
-}
-
-
-int MainWindow::countFiguresByType(const QString& type)
-{
-    QSqlQuery query;
-    query.prepare("SELECT COUNT(*) FROM figures WHERE type = ?");
-    query.addBindValue(type);
-
-    if (!query.exec()) {
-        QMessageBox::critical(this, "Error", "Failed to count figures: " + query.lastError().text());
-        return 0;
-    }
-
-    if (query.next()) {
-        return query.value(0).toInt() + 1;
-    }
-
-    return 1;
+    });
 }
 
 void MainWindow::addPolygon()
@@ -153,36 +230,14 @@ void MainWindow::addPolygon()
         return;
     }
 
-    QPolygonF polygon;
-    for (int i = 0; i < sides; ++i) {
-        qreal angle = (2 * M_PI * i) / sides;
-        qreal x = radius * qCos(angle);
-        qreal y = radius * qSin(angle);
-        polygon << QPointF(x, y);
-    }
-
-    QGraphicsPolygonItem *polygonItem = scene->addPolygon(polygon, QPen(Qt::black), QBrush(Qt::blue));
-
-
-    int itemId = getNextAvailableId();
-    polygonItem->setData(0, itemId);
-    polygonItem->setData(1, "polygon");
-    int count = countFiguresByType("polygon");
-
-
-    QSqlQuery query;
-    query.prepare("INSERT INTO figures (id, type, related_ids, type_count) VALUES (?, ?, ?, ?)");
-    query.addBindValue(itemId);
-    query.addBindValue("polygon");
-    query.addBindValue("");
-    query.addBindValue(count);
-
-    if (!query.exec()) {
-        QMessageBox::critical(this, "Error", "Failed to add polygon: " + query.lastError().text());
-    } else {
-        updateTypeCount("polygon");
-        updateDelegate();
-        model->select();
+    const int id = createPolygon(sides, radius);
+    if (id >= 0) {
+        recorder->recordAction(QString("polygon %1 %2 %3").arg(sides).arg(radius).arg(id));
+        GeometryCache::Stats stats = GeometryCache::instance().stats();
+        NodeStore::MemoryStats memory = scene->nodeStore().memory();
+        ui->statusBar->showMessage(QString("Shape cache: %1 shapes, %2 KB; nodes: %3 at %4 bytes each")
+                                   .arg(stats.entries).arg(stats.bytes / 1024.0, 0, 'f', 1)
+                                   .arg(memory.nodes).arg(memory.bytesPerNode, 0, 'f', 1));
     }
 }
 
@@ -204,26 +259,9 @@ void MainWindow::addEllipse()
         return;
     }
 
-    QGraphicsEllipseItem *ellipseItem = scene->addEllipse(-width/2, -height/2, width, height, QPen(Qt::black), QBrush(Qt::green));
-
-    int itemId = getNextAvailableId();
-    ellipseItem->setData(0, itemId);
-    ellipseItem->setData(1, "ellipse");
-    int count = countFiguresByType("ellipse");
-
-    QSqlQuery query;
-    query.prepare("INSERT INTO figures (id, type, related_ids, type_count) VALUES (?, ?, ?, ?)");
-    query.addBindValue(itemId);
-    query.addBindValue("ellipse");
-    query.addBindValue("");
-    query.addBindValue(count);
-
-    if (!query.exec()) {
-        QMessageBox::critical(this, "Error", "Failed to add ellipse: " + query.lastError().text());
-    } else {
-        updateTypeCount("ellipse");
-        updateDelegate();
-        model->select();
+    const int id = createEllipse(width, height);
+    if (id >= 0) {
+        recorder->recordAction(QString("ellipse %1 %2 %3").arg(width).arg(height).arg(id));
     }
 }
 
@@ -245,204 +283,347 @@ void MainWindow::addRectangle()
         return;
     }
 
-    QGraphicsRectItem *rectItem = scene->addRect(-width, -height, width, height, QPen(Qt::black), QBrush(Qt::red));
-    int itemId = getNextAvailableId();
-    rectItem->setData(0, itemId);
-    rectItem->setData(1, "rectangle");
-    int count = countFiguresByType("rectangle");
-
+    const int id = createRectangle(width, height);
+    if (id >= 0) {
+        recorder->recordAction(QString("rectangle %1 %2 %3").arg(width).arg(height).arg(id));
+    }
+}
 
-    QSqlQuery query;
-    query.prepare("INSERT INTO figures (id, type, related_ids, type_count) VALUES (?, ?, ?, ?)");
-    query.addBindValue(itemId);
-    query.addBindValue("rectangle");
-    query.addBindValue("");
-    query.addBindValue(count);
+int MainWindow::createPolygon(int sides, double radius, int id)
+{
+    return insertFigure(FigureKind::Polygon, QSizeF(2 * radius, 2 * radius), sides, id);
+}
 
-    if (!query.exec()) {
-        QMessageBox::critical(this, "Error", "Failed to add rectangle: " + query.lastError().text());
-    } else {
-        updateTypeCount("rectangle");
-        updateDelegate();
-        model->select();
-    }
+int MainWindow::createEllipse(int width, int height, int id)
+{
+    return insertFigure(FigureKind::Ellipse, QSizeF(width, height), 0, id);
 }
 
-void MainWindow::updateTypeCountDel(const QString &type)
+int MainWindow::createRectangle(int width, int height, int id)
 {
+    return insertFigure(FigureKind::Rectangle, QSizeF(width, height), 0, id);
+}
 
-    QSqlQuery query;
-    query.prepare("SELECT id FROM figures WHERE type = ?");
-    query.addBindValue(type);
+int MainWindow::insertFigure(FigureKind kind, const QSizeF &size, int sides, int id)
+{
+    // An explicit id comes from a replayed trace, which pins the id each
+    // figure got when it was recorded.
+    int itemId = id;
+    if (itemId >= 0 && scene->itemById(itemId)) {
+        reportError(QString("Failed to add %1: id %2 is taken").arg(figureKindName(kind)).arg(itemId));
+        return -1;
+    }
+    if (itemId >= 0 && !idAllocator->skipPast(itemId)) {
+        reportError(QString("Failed to add %1 with id %2: %3").arg(figureKindName(kind)).arg(itemId)
+                    .arg(idAllocator->lastError()));
+        return -1;
+    }
+    if (itemId < 0) {
+        itemId = idAllocator->next();
+    }
+    if (itemId < 0) {
+        reportError("Failed to add " + figureKindName(kind) + ": no free id: " + idAllocator->lastError());
+        return -1;
+    }
+    scene->addFigure(itemId, kind, size, sides);
 
-    if (query.exec()) {
-        int count = 0;
-        while (query.next()) {
-            ++count;
-        }
+    if (!store.insertFigure(itemId, kind)) {
+        reportError("Failed to add " + figureKindName(kind) + ": " + store.lastError());
+        scene->removeFigures(QVector<int>{ itemId });
+        return -1;
+    }
 
+    updateDelegate();
+    model->figureAdded(itemId, kind);
+    return itemId;
+}
 
-        query.prepare("UPDATE figures SET type_count = ? WHERE type = ?");
-        query.addBindValue(count - 1);
-        query.addBindValue(type);
+bool MainWindow::startAutosave(const QString &directory)
+{
+    if (journal) {
+        return false;
+    }
 
-        if (!query.exec()) {
-            QMessageBox::critical(this, "Error", "Failed to update type_count: " + query.lastError().text());
+    ChangeJournal::State state;
+    QString error;
+    QElapsedTimer timer;
+    timer.start();
+    if (!ChangeJournal::load(directory, &state, &error)) {
+        // Journaling on top of files we could not read would overwrite them
+        // at the next compaction, so autosave stays off.
+        reportError("Failed to recover the autosave: " + error);
+        return false;
+    }
+    restoreState(state);
+
+    journal = new ChangeJournal(directory);
+    if (!journal->start(state)) {
+        reportError("Failed to start autosave: " + journal->lastError());
+        delete journal;
+        journal = nullptr;
+        return false;
+    }
+    scene->setJournal(journal);
+
+    if (!state.nodes.isEmpty()) {
+        const QString message = QString("Recovered %1 figures and %2 links in %3 ms")
+                .arg(state.nodes.size()).arg(state.links.size()).arg(timer.elapsed());
+        ui->statusBar->showMessage(message);
+        if (batchMode) {
+            QTextStream(stdout) << message << "\n";
         }
-    } else {
-        QMessageBox::critical(this, "Error", "Failed to fetch figures by type: " + query.lastError().text());
     }
+    return true;
 }
 
-void MainWindow::updateTypeCount(const QString &type)
+bool MainWindow::canRestore(QString *error) const
 {
+    // Restored figures keep their ids, which would collide with anything
+    // created already, or with an id block already reserved.
+    if (scene->figureCount() > 0 || idAllocator->hasReserved()) {
+        *error = "the scene must be empty before any figures are created";
+        return false;
+    }
+    return true;
+}
 
-    QSqlQuery query;
-    query.prepare("SELECT id FROM figures WHERE type = ?");
-    query.addBindValue(type);
-
-    if (query.exec()) {
-        int count = 0;
-        while (query.next()) {
-            ++count;
+bool MainWindow::restoreState(const ChangeJournal::State &state)
+{
+    QVector<int> ids;
+    QVector<QPointF> positions;
+    QVector<int> hidden;
+    ids.reserve(state.nodes.size());
+    positions.reserve(state.nodes.size());
+    for (auto it = state.nodes.constBegin(); it != state.nodes.constEnd(); ++it) {
+        const ChangeJournal::Node &node = it.value();
+        scene->addFigure(it.key(), node.kind, node.size, node.sides);
+        ids.append(it.key());
+        positions.append(node.pos);
+        if (node.hidden) {
+            hidden.append(it.key());
         }
+    }
+    scene->setFigurePositions(ids, positions);
+    QVector<QPair<int, int>> links;
+    links.reserve(state.links.size());
+    for (quint64 key : state.links) {
+        links.append(ChangeJournal::State::linkIds(key));
+    }
+    scene->connectFigures(links);
+    scene->setHidden(hidden, true);
 
+    const bool restored = store.restore(state);
+    if (!restored) {
+        reportError("Failed to restore the figures table: " + store.lastError());
+    }
+    if (!state.nodes.isEmpty()) {
+        updateDelegate();
+    }
+    model->reload();
+    return restored;
+}
 
-        query.prepare("UPDATE figures SET type_count = ? WHERE type = ?");
-        query.addBindValue(count);
-        query.addBindValue(type);
+void MainWindow::startLayout(bool newOnly)
+{
+    if (scene->isLayoutRunning()) {
+        ui->statusBar->showMessage("A layout is already running");
+        return;
+    }
+    if (!scene->startLayout(newOnly)) {
+        ui->statusBar->showMessage(newOnly ? "No new figures to lay out" : "Nothing to lay out");
+        return;
+    }
+    ui->statusBar->showMessage("Laying out...");
+    recorder->recordAction(newOnly ? "layout new" : "layout");
+}
 
-        if (!query.exec()) {
-            QMessageBox::critical(this, "Error", "Failed to update type_count: " + query.lastError().text());
-        }
+void MainWindow::reportError(const QString &message)
+{
+    if (batchMode) {
+        qWarning().noquote() << message;
     } else {
-        QMessageBox::critical(this, "Error", "Failed to fetch figures by type: " + query.lastError().text());
+        QMessageBox::critical(this, "Error", message);
     }
 }
 
-void MainWindow::deleteSelectedItem() {
-    int id = -1;
-
-
-    QModelIndexList selectedIndexes = ui->tableView->selectionModel()->selectedRows();
-    if (!selectedIndexes.isEmpty()) {
-        id = selectedIndexes.first().data().toInt();
-    } else if (selectedSceneItemId != -1) {
-        id = selectedSceneItemId;
+int MainWindow::createPairs(const QVector<QPair<int, int>> &pairs)
+{
+    const QVector<QPair<int, int>> added = scene->connectFigures(pairs);
+    if (!store.link(added)) {
+        reportError("Failed to store the links: " + store.lastError());
+        scene->disconnectFigures(added);
+        return -1;
     }
+    return added.size();
+}
 
-    if (id == -1) {
-        QMessageBox::warning(this, "Warning", "No item selected for deletion.");
-        return;
+int MainWindow::deletePairs(const QVector<QPair<int, int>> &pairs)
+{
+    const QVector<QPair<int, int>> removed = scene->disconnectFigures(pairs);
+    if (!store.unlink(removed)) {
+        reportError("Failed to remove the links: " + store.lastError());
+        scene->connectFigures(removed);
+        return -1;
     }
+    return removed.size();
+}
 
-    QSqlQuery query;
-    query.prepare("SELECT related_ids FROM figures WHERE id = ?");
-    query.addBindValue(id);
+bool MainWindow::linkFigures(int id1, int id2)
+{
+    const int added = createPairs(QVector<QPair<int, int>>{ qMakePair(id1, id2) });
+    if (added == 0) {
+        reportError(QString("Cannot link figures %1 and %2").arg(id1).arg(id2));
+    }
+    return added > 0;
+}
 
-    if (query.exec() && query.next()) {
-        QStringList relatedIds = query.value(0).toString().split(",", QString::SkipEmptyParts);
+bool MainWindow::unlinkFigures(int id1, int id2)
+{
+    const int removed = deletePairs(QVector<QPair<int, int>>{ qMakePair(id1, id2) });
+    if (removed == 0) {
+        reportError(QString("Figures %1 and %2 are not linked").arg(id1).arg(id2));
+    }
+    return removed > 0;
+}
 
-        for (const QString &relatedId : relatedIds) {
-            query.prepare("SELECT related_ids FROM figures WHERE id = ?");
-            query.addBindValue(relatedId.toInt());
-            if (query.exec() && query.next()) {
-                QStringList idsToUpdate = query.value(0).toString().split(",", QString::SkipEmptyParts);
-                idsToUpdate.removeAll(QString::number(id));
+bool MainWindow::readPairs(const QString &fileName, QVector<QPair<int, int>> *pairs, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = file.errorString();
+        return false;
+    }
 
-                query.prepare("UPDATE figures SET related_ids = ? WHERE id = ?");
-                query.addBindValue(idsToUpdate.join(","));
-                query.addBindValue(relatedId.toInt());
-                query.exec();
-            }
+    // One "ID1 ID2" pair per line, separated by spaces, tabs or a comma.
+    QTextStream in(&file);
+    QString line;
+    int lineNumber = 0;
+    while (in.readLineInto(&line)) {
+        ++lineNumber;
+        line.replace(QLatin1Char(','), QLatin1Char(' ')).replace(QLatin1Char('\t'), QLatin1Char(' '));
+        const QVector<QStringRef> fields = line.splitRef(QLatin1Char(' '), Qt::SkipEmptyParts);
+        if (fields.isEmpty() || fields.first().startsWith('#')) {
+            continue;
+        }
+        bool ok1 = false, ok2 = false;
+        const int id1 = fields.size() == 2 ? fields.at(0).toInt(&ok1) : 0;
+        const int id2 = fields.size() == 2 ? fields.at(1).toInt(&ok2) : 0;
+        if (!ok1 || !ok2) {
+            *error = QString("%1:%2: expected two figure ids").arg(fileName).arg(lineNumber);
+            return false;
         }
+        pairs->append(qMakePair(id1, id2));
     }
+    return true;
+}
 
-    query.prepare("SELECT type FROM figures WHERE id = ?");
-    query.addBindValue(id);
-    if (query.exec() && query.next()) {
-        QString type = query.value(0).toString();
-        updateTypeCountDel(type);
-        updateDelegate();
+void MainWindow::importLinks()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, "Import Links", QString(), "Text files (*.txt *.csv);;All files (*)");
+    if (fileName.isEmpty()) {
+        return;
     }
 
+    QVector<QPair<int, int>> pairs;
+    QString error;
+    if (!readPairs(fileName, &pairs, &error)) {
+        reportError("Failed to read links: " + error);
+        return;
+    }
 
-    query.prepare("DELETE FROM figures WHERE id = ?");
-    query.addBindValue(id);
-
+    const int added = createPairs(pairs);
+    if (added >= 0) {
+        model->linksChanged();
+        ui->statusBar->showMessage(QString("%1 links added, %2 skipped").arg(added).arg(pairs.size() - added));
+        if (TraceRecorder::isScriptSafe(fileName)) {
+            recorder->recordAction("link-file " + fileName);
+        }
+    }
+}
 
-    scene->deleteRelatedLines(id);
+void MainWindow::deleteSelectedItem() {
+    QVector<int> ids = selectedIds();
+    if (ids.isEmpty() && selectedSceneItemId != -1) {
+        ids.append(selectedSceneItemId);
+    }
 
-    if (query.exec()) {
+    if (ids.isEmpty()) {
+        QMessageBox::warning(this, "Warning", "No item selected for deletion.");
+        return;
+    }
 
-        for (QGraphicsItem *item : scene->items()) {
-            if (item->data(0).toInt() == id) {
-                scene->removeItem(item);
-                delete item;
-                break;
-            }
-        }
+    if (removeFigures(ids)) {
+        ui->statusBar->showMessage(QString("%1 figures deleted").arg(ids.size()));
+        recorder->recordAction("delete " + joinIds(ids));
+    }
+}
 
-        model->select();
-        selectedSceneItemId = -1;
-    } else {
-        QMessageBox::critical(this, "Error", "Failed to delete item: " + query.lastError().text());
+bool MainWindow::removeFigures(const QVector<int> &ids)
+{
+    if (!store.deleteFigures(ids)) {
+        reportError("Failed to delete figures: " + store.lastError());
+        return false;
     }
+
+    scene->removeFigures(ids);
+    model->invalidate();
+    selectedSceneItemId = -1;
+    return true;
 }
 
 void MainWindow::onFilterButtonClicked()
 {
+    FigureFilter filter;
 
     QString selectedType = ui->filterComboBox->currentText();
-
-    if (selectedType == "Все") {
-
-        model->setFilter("");
-        model->select();
-        filterSceneItems("");
-    } else {
-        QString sqlType;
+    if (selectedType != "Все") {
+        filter.allTypes = false;
         if (selectedType == "Полигон") {
-            sqlType = "polygon";
+            filter.kind = FigureKind::Polygon;
         } else if (selectedType == "Эллипс") {
-            sqlType = "ellipse";
+            filter.kind = FigureKind::Ellipse;
         } else if (selectedType == "Прямоугольник") {
-            sqlType = "rectangle";
+            filter.kind = FigureKind::Rectangle;
         }
+    }
 
+    bool ok;
+    int minId = ui->minIdEdit->text().toInt(&ok);
+    if (ok) {
+        filter.minId = minId;
+    }
+    int maxId = ui->maxIdEdit->text().toInt(&ok);
+    if (ok) {
+        filter.maxId = maxId;
+    }
 
-        model->setFilter(QString("type = '%1'").arg(sqlType));
-        model->select();
-
+    filter.connectivity = FigureFilter::Connectivity(ui->connectivityComboBox->currentIndex());
 
-        filterSceneItems(sqlType);
-    }
+    applyFigureFilter(filter);
+    recorder->recordAction(QString("filter %1 %2 %3 %4")
+                           .arg(filter.allTypes ? QString("all") : figureKindName(filter.kind))
+                           .arg(filter.minId).arg(filter.maxId)
+                           .arg(connectivityNames.at(filter.connectivity)));
 }
 
-void MainWindow::filterSceneItems(const QString &typeFilter)
+void MainWindow::applyFigureFilter(const FigureFilter &filter)
 {
-    for (QGraphicsItem *item : scene->items()) {
-        QString type = item->data(1).toString();
-
-        if (typeFilter.isEmpty() || type == typeFilter) {
-            item->setVisible(true);
-        } else {
-            item->setVisible(false);
-        }
-    }
+    model->setFigureFilter(filter);
+    scene->applyFilter(filter);
 }
 
 void MainWindow::onSceneItemSelected(int itemId)
 {
+    selectedSceneItemId = itemId;
 
-    for (int row = 0; row < model->rowCount(); ++row) {
-        QModelIndex index = model->index(row, 0);
-        if (index.data().toInt() == itemId) {
-            ui->tableView->selectRow(row);
-            selectedSceneItemId = itemId;
-            return;
-        }
+    int row = model->rowForId(itemId);
+    if (row < 0) {
+        return;
     }
+
+    QModelIndex index = model->index(row, 0);
+    ui->tableView->selectRow(index.row());
+    ui->tableView->scrollTo(index);
 }
 
 void MainWindow::deletePair() {
@@ -463,10 +644,10 @@ void MainWindow::deletePair() {
     }
 
 
-    scene->deletePair(id1, id2);
-
-
-    model->select();
+    if (unlinkFigures(id1, id2)) {
+        model->linksChanged();
+        recorder->recordAction(QString("unlink %1 %2").arg(id1).arg(id2));
+    }
 }
 
 void MainWindow::hideConnections() {
@@ -476,11 +657,377 @@ void MainWindow::hideConnections() {
         return;
     }
 
-    int selectedId = item->data(0).toInt();
+    int selectedId = FigureItem::idOf(item);
+
+    QStringList modes;
+    modes << "Neighbors" << "Everything reachable" << "Only its component" << "K-hop neighborhood";
 
-    scene->hideConnections(selectedId);
+    bool ok;
+    QString mode = QInputDialog::getItem(this, "Hide Connections", "Hide:", modes, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+
+    if (mode == modes[0]) {
+        scene->hideConnections(selectedId);
+    } else if (mode == modes[1]) {
+        scene->queryConnections(selectedId, ConnectionQuery::Reachable);
+    } else if (mode == modes[2]) {
+        scene->queryConnections(selectedId, ConnectionQuery::Component);
+    } else {
+        int hops = QInputDialog::getInt(this, "Hide Connections", "Number of hops:", 2, 1, 1000, 1, &ok);
+        if (!ok) {
+            return;
+        }
+        scene->queryConnections(selectedId, ConnectionQuery::Neighborhood, hops);
+    }
 
     qDebug() << "Connections hidden for figure ID:" << selectedId;
 }
 
+QVector<int> MainWindow::selectedIds() const
+{
+    QSet<int> ids;
+    for (const QModelIndex &index : ui->tableView->selectionModel()->selectedRows()) {
+        ids.insert(index.data().toInt());
+    }
+    for (QGraphicsItem *item : scene->selectedItems()) {
+        int id = FigureItem::idOf(item);
+        if (id >= 0) {
+            ids.insert(id);
+        }
+    }
+    return QVector<int>(ids.begin(), ids.end());
+}
 
+bool MainWindow::setFiguresHidden(const QVector<int> &ids, bool hidden)
+{
+    if (ids.isEmpty()) {
+        return true;
+    }
+
+    if (!store.setHidden(ids, hidden)) {
+        reportError("Failed to update hidden figures: " + store.lastError());
+        return false;
+    }
+
+    scene->setHidden(ids, hidden);
+    model->refreshColumn(4);
+    ui->statusBar->showMessage(QString("%1 figures %2").arg(ids.size()).arg(hidden ? "hidden" : "shown"));
+    return true;
+}
+
+void MainWindow::hideSelected()
+{
+    QVector<int> ids = selectedIds();
+    if (ids.isEmpty()) {
+        QMessageBox::warning(this, "Warning", "No figures selected.");
+        return;
+    }
+    if (setFiguresHidden(ids, true)) {
+        recorder->recordAction("hide " + joinIds(ids));
+    }
+}
+
+void MainWindow::showHidden()
+{
+    scene->showAll();
+
+    QVector<int> ids;
+    for (int id : selectedIds()) {
+        if (scene->isHidden(id)) {
+            ids.append(id);
+        }
+    }
+    if (ids.isEmpty()) {
+        ids = store.hiddenIds();
+    }
+    if (!ids.isEmpty() && setFiguresHidden(ids, false)) {
+        recorder->recordAction("show " + joinIds(ids));
+    }
+}
+
+void MainWindow::onConnectionsFound(int id, ConnectionQuery query, const QVector<int> &ids)
+{
+    Q_UNUSED(id)
+    // A query is a way of looking at the scene, not an edit: its result, or
+    // for a component everything else, is hidden in the view only, until
+    // Show Hidden. Only Hide Selected stores hidden figures.
+    if (query != ConnectionQuery::Component) {
+        scene->hideInView(ids);
+        ui->statusBar->showMessage(QString("Hid %1 connected figures in the view").arg(ids.size()));
+        return;
+    }
+
+    scene->showOnly(ids);
+    ui->statusBar->showMessage(QString("Showing a component of %1 figures").arg(ids.size()));
+}
+
+void MainWindow::exportImage()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Export PNG", "figures.png", "PNG images (*.png)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    SceneExporter exporter(scene);
+    if (!exporter.exportImage(fileName)) {
+        QMessageBox::critical(this, "Error", "Failed to export the scene: " + exporter.lastError());
+    }
+}
+
+void MainWindow::exportTiles()
+{
+    QString dirPath = QFileDialog::getExistingDirectory(this, "Export Tiles");
+    if (dirPath.isEmpty()) {
+        return;
+    }
+
+    SceneExporter exporter(scene);
+    if (!exporter.exportPyramid(dirPath)) {
+        QMessageBox::critical(this, "Error", "Failed to export the scene: " + exporter.lastError());
+    }
+}
+
+bool MainWindow::runScript(const QString &fileName)
+{
+    auto parseIds = [](const QStringList &args, QVector<int> *ids, QString *error) {
+        for (const QString &arg : args) {
+            bool ok;
+            int id = arg.toInt(&ok);
+            if (!ok) {
+                *error = "invalid id " + arg;
+                return false;
+            }
+            ids->append(id);
+        }
+        return true;
+    };
+
+    // Recorded traces name the id each figure was created with.
+    auto optionalId = [](const QStringList &args, int index, int *id, QString *error) {
+        *id = -1;
+        if (args.size() <= index) {
+            return true;
+        }
+        bool ok;
+        *id = args.at(index).toInt(&ok);
+        if (!ok || *id < 0) {
+            *error = "invalid id " + args.at(index);
+            return false;
+        }
+        return true;
+    };
+
+    auto figureSize = [](const QString &command, const QStringList &args, QSize *size, QString *error) {
+        bool okWidth, okHeight;
+        *size = QSize(args.at(0).toInt(&okWidth), args.at(1).toInt(&okHeight));
+        if (!okWidth || !okHeight || size->width() <= 0 || size->height() <= 0) {
+            *error = "usage: " + command + " WIDTH HEIGHT [ID], with WIDTH and HEIGHT positive integers";
+            return false;
+        }
+        return true;
+    };
+
+    ScriptRunner runner;
+    runner.addCommand("polygon", 1, "SIDES [RADIUS [ID]]", [this, optionalId](const QStringList &args, QString *error) {
+        int sides = args.at(0).toInt();
+        if (sides < 3) {
+            *error = "a polygon needs at least 3 sides";
+            return false;
+        }
+        int id;
+        return optionalId(args, 2, &id, error) && createPolygon(sides, args.value(1, "50").toDouble(), id) >= 0;
+    });
+    runner.addCommand("ellipse", 2, "WIDTH HEIGHT [ID]", [this, figureSize, optionalId](const QStringList &args, QString *error) {
+        QSize size;
+        int id;
+        return figureSize("ellipse", args, &size, error) && optionalId(args, 2, &id, error)
+                && createEllipse(size.width(), size.height(), id) >= 0;
+    });
+    runner.addCommand("rectangle", 2, "WIDTH HEIGHT [ID]", [this, figureSize, optionalId](const QStringList &args, QString *error) {
+        QSize size;
+        int id;
+        return figureSize("rectangle", args, &size, error) && optionalId(args, 2, &id, error)
+                && createRectangle(size.width(), size.height(), id) >= 0;
+    });
+    runner.addCommand("link", 2, "ID1 ID2", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        if (!parseIds(args.mid(0, 2), &ids, error)) {
+            *error = "usage: link ID1 ID2, with integer ids";
+            return false;
+        }
+        const int id1 = ids.at(0);
+        const int id2 = ids.at(1);
+        if (id1 == id2 || !scene->itemById(id1) || !scene->itemById(id2)) {
+            *error = "cannot link these figures";
+            return false;
+        }
+        if (!linkFigures(id1, id2)) {
+            return false;
+        }
+        model->linksChanged();
+        return true;
+    });
+    runner.addCommand("unlink", 2, "ID1 ID2", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        if (!parseIds(args.mid(0, 2), &ids, error)) {
+            *error = "usage: unlink ID1 ID2, with integer ids";
+            return false;
+        }
+        if (!unlinkFigures(ids.at(0), ids.at(1))) {
+            return false;
+        }
+        model->linksChanged();
+        return true;
+    });
+    runner.addCommand("link-file", 1, "FILE", [this](const QStringList &args, QString *error) {
+        QVector<QPair<int, int>> pairs;
+        if (!readPairs(args.at(0), &pairs, error)) {
+            return false;
+        }
+        const int added = createPairs(pairs);
+        if (added < 0) {
+            return false;
+        }
+        QTextStream(stdout) << "link-file: " << added << " added, " << pairs.size() - added << " skipped\n";
+        model->linksChanged();
+        return true;
+    });
+    runner.addCommand("unlink-file", 1, "FILE", [this](const QStringList &args, QString *error) {
+        QVector<QPair<int, int>> pairs;
+        if (!readPairs(args.at(0), &pairs, error)) {
+            return false;
+        }
+        const int removed = deletePairs(pairs);
+        if (removed < 0) {
+            return false;
+        }
+        QTextStream(stdout) << "unlink-file: " << removed << " removed, " << pairs.size() - removed << " skipped\n";
+        model->linksChanged();
+        return true;
+    });
+    runner.addCommand("filter", 1, "all|polygon|ellipse|rectangle [MIN_ID [MAX_ID [any|connected|isolated]]]",
+                      [this](const QStringList &args, QString *error) {
+        FigureFilter filter;
+        if (args.at(0) != "all") {
+            filter.allTypes = false;
+            filter.kind = figureKindFromName(args.at(0));
+            if (filter.kind == FigureKind::Unknown) {
+                *error = "unknown figure type " + args.at(0);
+                return false;
+            }
+        }
+        filter.minId = args.value(1, "-1").toInt();
+        filter.maxId = args.value(2, "-1").toInt();
+        if (args.size() > 3) {
+            const int connectivity = connectivityNames.indexOf(args.at(3));
+            if (connectivity < 0) {
+                *error = "unknown connectivity " + args.at(3);
+                return false;
+            }
+            filter.connectivity = FigureFilter::Connectivity(connectivity);
+        }
+        applyFigureFilter(filter);
+        return true;
+    });
+    runner.addCommand("delete", 1, "ID...", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        return parseIds(args, &ids, error) && removeFigures(ids);
+    });
+    runner.addCommand("hide", 1, "ID...", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        if (!parseIds(args, &ids, error)) {
+            return false;
+        }
+        return setFiguresHidden(ids, true);
+    });
+    runner.addCommand("show", 1, "ID...", [this, parseIds](const QStringList &args, QString *error) {
+        QVector<int> ids;
+        if (!parseIds(args, &ids, error)) {
+            return false;
+        }
+        return setFiguresHidden(ids, false);
+    });
+    SceneCommands::addTransforms(runner, [this](const QTransform &transform) {
+        scene->transformFigures(scene->figureIds(), transform);
+    });
+    SceneCommands::addLayout(runner, scene);
+    runner.addCommand("memory", 0, "", [this](const QStringList &, QString *) {
+        NodeStore::MemoryStats memory = scene->nodeStore().memory();
+        QTextStream(stdout) << "nodes " << memory.nodes << ", arrays " << memory.arrayBytes
+                            << " B, index " << memory.indexBytes << " B, "
+                            << QString::number(memory.bytesPerNode, 'f', 1) << " B/node\n";
+        return true;
+    });
+    runner.addCommand("autosave", 1, "DIR", [this](const QStringList &args, QString *error) {
+        if (!canRestore(error)) {
+            return false;
+        }
+        if (!startAutosave(args.at(0))) {
+            *error = "autosave is already on or could not be started";
+            return false;
+        }
+        return true;
+    });
+    runner.addCommand("autosave-flush", 0, "[compact]", [this](const QStringList &args, QString *error) {
+        if (!journal) {
+            *error = "autosave is off";
+            return false;
+        }
+        journal->flush(args.value(0) == "compact");
+        const ChangeJournal::Stats stats = journal->stats();
+        QTextStream(stdout) << "journal: " << stats.written << " records written, "
+                            << stats.compactions << " compactions, " << stats.journalBytes << " B pending\n";
+        return journal->lastError().isEmpty();
+    });
+    SceneCommands::addChurn<FigureItem, CustomLine>(runner, [this](int count) {
+        // Scene-only figures in an id range the allocator never reaches.
+        const int base = 1 << 30;
+        QVector<int> ids(count);
+        scene->setJournal(nullptr);
+        for (int i = 0; i < count; ++i) {
+            ids[i] = base + i;
+            scene->addFigure(ids[i], FigureKind::Rectangle, QSizeF(20, 10));
+        }
+        for (int i = 1; i < count; ++i) {
+            scene->connectFigures(ids[i - 1], ids[i]);
+        }
+        scene->removeFigures(ids);
+        scene->setJournal(journal);
+    });
+    runner.addCommand("export", 1, "FILE", [this](const QStringList &args, QString *error) {
+        SceneExporter exporter(scene);
+        if (!exporter.exportImage(args.at(0))) {
+            *error = exporter.lastError();
+            return false;
+        }
+        return true;
+    });
+    runner.addCommand("export-tiles", 1, "DIR", [this](const QStringList &args, QString *error) {
+        SceneExporter exporter(scene);
+        if (!exporter.exportPyramid(args.at(0))) {
+            *error = exporter.lastError();
+            return false;
+        }
+        return true;
+    });
+    TraceReplayer::addCommand(runner, scene, [this](const ChangeJournal::State &state, QString *error) {
+        if (!canRestore(error)) {
+            return false;
+        }
+        if (!restoreState(state)) {
+            *error = "cannot restore the trace's starting scene";
+            return false;
+        }
+        return true;
+    });
+
+    bool ok = runner.run(fileName);
+    QTextStream out(stdout);
+    runner.printReport(out);
+    if (!runner.lastError().isEmpty()) {
+        QTextStream(stderr) << runner.lastError() << "\n";
+    }
+    return ok;
+}
@@ -2,13 +2,17 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QSqlTableModel>
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QSqlDatabase>
 #include <QPushButton>
 #include <QTableView>
 #include "customscene.h"
+#include "figurepagemodel.h"
+#include "figurestore.h"
+#include "idallocator.h"
+#include "changejournal.h"
+#include "tracerecorder.h"
 
 namespace Ui {
 class MainWindow;
@@ -19,34 +23,60 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget *parent = nullptr);
+    explicit MainWindow(QWidget *parent = nullptr, bool batchMode = false);
     ~MainWindow();
 
+    bool runScript(const QString &fileName);
+
 private slots:
     void addPolygon();
     void addEllipse();
     void addRectangle();
     void deleteSelectedItem();
     void onFilterButtonClicked();
-    void filterSceneItems(const QString &typeFilter);
-    void updateTypeCount(const QString &type);
-    void updateTypeCountDel(const QString &type);
     void deletePair();
     void hideConnections();
+    void hideSelected();
+    void showHidden();
+    void onConnectionsFound(int id, ConnectionQuery query, const QVector<int> &ids);
+    void exportImage();
+    void exportTiles();
+    void importLinks();
 
 private:
     Ui::MainWindow *ui;
-    QSqlTableModel *model;
+    FigurePageModel *model;
     CustomScene *scene;
+    FigureStore store;
+    IdAllocator *idAllocator;
+    ChangeJournal *journal = nullptr;
+    TraceRecorder *recorder;
     int selectedSceneItemId = -1;
+    bool batchMode;
     QGraphicsItem* findItemById(int itemId);
 
     void initializeDatabase();
     void updateDelegate();
     void setupConnections();
     void onSceneItemSelected(int itemId);
-    int getNextAvailableId();
-    int countFiguresByType(const QString& type);
+    QVector<int> selectedIds() const;
+    int createPolygon(int sides, double radius, int id = -1);
+    int createEllipse(int width, int height, int id = -1);
+    int createRectangle(int width, int height, int id = -1);
+    int insertFigure(FigureKind kind, const QSizeF &size, int sides = 0, int id = -1);
+    bool removeFigures(const QVector<int> &ids);
+    int createPairs(const QVector<QPair<int, int>> &pairs);
+    int deletePairs(const QVector<QPair<int, int>> &pairs);
+    bool linkFigures(int id1, int id2);
+    bool unlinkFigures(int id1, int id2);
+    static bool readPairs(const QString &fileName, QVector<QPair<int, int>> *pairs, QString *error);
+    void applyFigureFilter(const FigureFilter &filter);
+    void startLayout(bool newOnly);
+    bool startAutosave(const QString &directory);
+    bool canRestore(QString *error) const;
+    bool restoreState(const ChangeJournal::State &state);
+    void reportError(const QString &message);
+    bool setFiguresHidden(const QVector<int> &ids, bool hidden);
 };
 
 #endif // MAINWINDOW_H
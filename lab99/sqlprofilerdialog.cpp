@@ -0,0 +1,71 @@
+#include "sqlprofilerdialog.h"
+#include "sqlexecutor.h"
+#include <QHeaderView>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+SqlProfilerDialog::SqlProfilerDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle("SQL Profile");
+    resize(900, 400);
+
+    table = new QTableWidget(this);
+    table->setColumnCount(8);
+    table->setHorizontalHeaderLabels(QStringList() << "Call site" << "Calls" << "Failed" << "Total ms"
+                                     << "Mean ms" << "Max ms" << "Rows" << "SQL");
+    table->horizontalHeader()->setStretchLastSection(true);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+
+    thresholdSpinBox = new QSpinBox(this);
+    thresholdSpinBox->setRange(0, 60000);
+    thresholdSpinBox->setSuffix(" ms");
+    thresholdSpinBox->setValue(int(SqlExecutor::instance().slowThreshold()));
+    connect(thresholdSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, [](int value) {
+        SqlExecutor::instance().setSlowThreshold(value);
+    });
+
+    QPushButton *refreshButton = new QPushButton("Refresh", this);
+    QPushButton *resetButton = new QPushButton("Reset", this);
+    connect(refreshButton, &QPushButton::clicked, this, &SqlProfilerDialog::refresh);
+    connect(resetButton, &QPushButton::clicked, this, [this]() {
+        SqlExecutor::instance().reset();
+        refresh();
+    });
+
+    QHBoxLayout *controls = new QHBoxLayout;
+    controls->addWidget(new QLabel("Slow query log threshold:", this));
+    controls->addWidget(thresholdSpinBox);
+    controls->addStretch();
+    controls->addWidget(refreshButton);
+    controls->addWidget(resetButton);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(table);
+    layout->addLayout(controls);
+
+    refresh();
+}
+
+void SqlProfilerDialog::refresh()
+{
+    const QVector<SqlExecutor::Aggregate> aggregates = SqlExecutor::instance().aggregates();
+    table->setRowCount(aggregates.size());
+
+    for (int row = 0; row < aggregates.size(); ++row) {
+        const SqlExecutor::Aggregate &aggregate = aggregates.at(row);
+        table->setItem(row, 0, new QTableWidgetItem(aggregate.site));
+        table->setItem(row, 1, new QTableWidgetItem(QString::number(aggregate.calls)));
+        table->setItem(row, 2, new QTableWidgetItem(QString::number(aggregate.failures)));
+        table->setItem(row, 3, new QTableWidgetItem(QString::number(aggregate.totalNs / 1e6, 'f', 2)));
+        table->setItem(row, 4, new QTableWidgetItem(QString::number(aggregate.totalNs / 1e6 / aggregate.calls, 'f', 3)));
+        table->setItem(row, 5, new QTableWidgetItem(QString::number(aggregate.maxNs / 1e6, 'f', 3)));
+        table->setItem(row, 6, new QTableWidgetItem(QString::number(aggregate.rows)));
+        table->setItem(row, 7, new QTableWidgetItem(aggregate.sql.simplified()));
+    }
+
+    table->resizeColumnsToContents();
+}
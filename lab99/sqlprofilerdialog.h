@@ -0,0 +1,22 @@
+#ifndef SQLPROFILERDIALOG_H
+#define SQLPROFILERDIALOG_H
+
+#include <QDialog>
+#include <QTableWidget>
+#include <QSpinBox>
+
+class SqlProfilerDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit SqlProfilerDialog(QWidget *parent = nullptr);
+
+public slots:
+    void refresh();
+
+private:
+    QTableWidget *table;
+    QSpinBox *thresholdSpinBox;
+};
+
+#endif // SQLPROFILERDIALOG_H
@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    core \
+    lab92 \
+    lab99
+
+lab92.depends = core
+lab99.depends = core